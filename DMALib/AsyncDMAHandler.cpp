@@ -0,0 +1,83 @@
+#include "AsyncDMAHandler.h"
+
+const char* toString(DMAInitPhase phase)
+{
+	switch (phase)
+	{
+	case DMAInitPhase::Queued: return "queued";
+	case DMAInitPhase::ConnectingDevice: return "connecting device";
+	case DMAInitPhase::AttachingProcess: return "attaching process";
+	case DMAInitPhase::Ready: return "ready";
+	case DMAInitPhase::Failed: return "failed";
+	default: return "unknown";
+	}
+}
+
+AsyncDMAHandler::AsyncDMAHandler(const wchar_t* wname, DMAInitOptions options)
+	: name(wname), options(std::move(options)), phaseStart(std::chrono::steady_clock::now()), future(promise.get_future().share())
+{
+}
+
+std::unique_ptr<AsyncDMAHandler> AsyncDMAHandler::create(const wchar_t* wname, DMAInitOptions options)
+{
+	std::unique_ptr<AsyncDMAHandler> async(new AsyncDMAHandler(wname, std::move(options)));
+	async->worker = std::thread([raw = async.get()] { raw->run(); });
+	return async;
+}
+
+AsyncDMAHandler::~AsyncDMAHandler()
+{
+	if (worker.joinable())
+		worker.join();
+}
+
+void AsyncDMAHandler::enter(DMAInitPhase next)
+{
+	std::lock_guard lock(timeMutex);
+	const auto now = std::chrono::steady_clock::now();
+	phaseTimes[static_cast<size_t>(phase.load())] += now - phaseStart;
+	phaseStart = now;
+	phase = next;
+}
+
+std::chrono::nanoseconds AsyncDMAHandler::getPhaseTime(DMAInitPhase phase) const
+{
+	std::lock_guard lock(timeMutex);
+	auto time = phaseTimes[static_cast<size_t>(phase)];
+	if (phase == this->phase && phase != DMAInitPhase::Ready && phase != DMAInitPhase::Failed)
+		time += std::chrono::steady_clock::now() - phaseStart;
+	return time;
+}
+
+void AsyncDMAHandler::run()
+{
+	try
+	{
+		enter(DMAInitPhase::ConnectingDevice);
+		auto backend = options.backend ? options.backend : DMAHandler::connect(options.memMap, options.cacheFile.empty() ? nullptr : options.cacheFile.c_str());
+
+		enter(DMAInitPhase::AttachingProcess);
+		handler = std::make_unique<DMAHandler>(name.c_str(), std::move(backend));
+
+		const bool initialized = handler->isInitialized();
+		enter(initialized ? DMAInitPhase::Ready : DMAInitPhase::Failed);
+
+		const auto ms = [this](DMAInitPhase phase) { return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(getPhaseTime(phase)).count()); };
+		const std::string narrow(name.begin(), name.end());
+		DMAHandler::log("%s %s: device %lld ms, process %lld ms", narrow.c_str(), initialized ? "ready" : "failed", ms(DMAInitPhase::ConnectingDevice), ms(DMAInitPhase::AttachingProcess));
+
+		promise.set_value(initialized);
+	}
+	catch (...)
+	{
+		enter(DMAInitPhase::Failed);
+		promise.set_exception(std::current_exception());
+	}
+}
+
+DMAHandler& AsyncDMAHandler::get()
+{
+	// rethrows whatever the worker threw
+	future.get();
+	return *handler;
+}
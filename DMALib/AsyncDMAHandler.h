@@ -0,0 +1,106 @@
+#pragma once
+#include "DMAHandler.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Steps of bringing up a DMAHandler, in order
+enum class DMAInitPhase
+{
+	Queued,
+	// loading the libraries, initializing the device and applying the memory map. Instant if the shared backend is connected already
+	ConnectingDevice,
+	// looking up the pid of the process
+	AttachingProcess,
+	Ready,
+	Failed,
+	Count
+};
+
+const char* toString(DMAInitPhase phase);
+
+struct DMAInitOptions
+{
+	// see the DMAHandler constructor
+	bool memMap = true;
+	// see the DMAHandler constructor, empty for none
+	std::string cacheFile;
+	// attaches through this backend instead of the shared VMM backend
+	std::shared_ptr<DMABackend> backend = nullptr;
+};
+
+/**
+ * \brief A DMAHandler that is brought up on a worker thread, so the caller can start its other subsystems
+ * or attach to several processes at once instead of waiting for every step in the constructor.
+ * The device is connected once, handlers created at the same time share it.
+ *
+ *	auto game = AsyncDMAHandler::create(L"game.exe");
+ *	auto launcher = AsyncDMAHandler::create(L"launcher.exe");
+ *	startOtherSubsystems();
+ *	if (game->ready().get())
+ *		game->get().read<int>(address);
+ *
+ * Not movable, the worker uses the object. The destructor waits for the worker.
+ */
+class AsyncDMAHandler
+{
+	std::wstring name;
+	DMAInitOptions options;
+	std::unique_ptr<DMAHandler> handler;
+
+	std::atomic<DMAInitPhase> phase = DMAInitPhase::Queued;
+	// time spent in every finished phase
+	std::array<std::chrono::nanoseconds, static_cast<size_t>(DMAInitPhase::Count)> phaseTimes{};
+	std::chrono::steady_clock::time_point phaseStart;
+	// guards phaseTimes and phaseStart
+	mutable std::mutex timeMutex;
+
+	std::promise<bool> promise;
+	std::shared_future<bool> future;
+
+	// Declared last, so it is joined before the state it uses goes away
+	std::thread worker;
+
+	AsyncDMAHandler(const wchar_t* wname, DMAInitOptions options);
+
+	// Ends the current phase and starts the next
+	void enter(DMAInitPhase next);
+
+	// Runs on the worker
+	void run();
+
+public:
+	/**
+	 * \brief starts bringing up a handler for the process and returns right away
+	 * \param wname process name, copied
+	 */
+	static std::unique_ptr<AsyncDMAHandler> create(const wchar_t* wname, DMAInitOptions options = {});
+
+	~AsyncDMAHandler();
+
+	AsyncDMAHandler(const AsyncDMAHandler&) = delete;
+	AsyncDMAHandler& operator=(const AsyncDMAHandler&) = delete;
+
+	// Becomes true once the handler is initialized, false if the device or the process could not be found
+	std::shared_future<bool> ready() const { return future; }
+
+	DMAInitPhase getPhase() const { return phase; }
+
+	// Whether the handler is initialized, never blocks
+	bool isReady() const { return phase == DMAInitPhase::Ready; }
+
+	// Time spent in the phase so far, e.g. to report progress while waiting
+	std::chrono::nanoseconds getPhaseTime(DMAInitPhase phase) const;
+
+	/**
+	 * \brief waits for the worker and returns the handler.
+	 * A handler that failed is returned as well, it is not initialized and throws on use like any other.
+	 */
+	DMAHandler& get();
+};
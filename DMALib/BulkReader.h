@@ -0,0 +1,182 @@
+#pragma once
+#include "DMAHandler.h"
+#include "RemoteStruct.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A field of the objects, the same descriptor as for RemoteView
+template <ULONG64 Offset, typename T>
+using BulkField = RemoteField<Offset, T>;
+
+/**
+ * \brief Reads the same fields from many objects in one scatter and stores them as struct of arrays,
+ * one contiguous column per field. Takes RemoteField declarations as well.
+ *
+ *	BulkReader<BulkField<0x10, Vector3>, BulkField<0x1C, int>, BulkField<0x20, ULONG64>> players(DMA);
+ *	players.read(playerPointers);
+ *	auto positions = players.column<0>();
+ *	auto health = players.column<1>();
+ *
+ * Fields at most maxGap bytes apart are fetched as one span per object, the bytes in between are thrown away.
+ * So the three fields above cost one scatter entry per object instead of three. A span holding a single field
+ * is read straight into its column, the others are copied out of a staging buffer.
+ */
+template <typename... Fields>
+class BulkReader
+{
+	static constexpr size_t FIELD_COUNT = sizeof...(Fields);
+	static_assert(FIELD_COUNT > 0, "a BulkReader needs at least one field");
+
+	static constexpr std::array<ULONG64, FIELD_COUNT> offsets = { Fields::offset... };
+	static constexpr std::array<DWORD, FIELD_COUNT> sizes = { static_cast<DWORD>(sizeof(typename Fields::type))... };
+
+	struct Span
+	{
+		ULONG64 offset;
+		DWORD size;
+		// position of the span in the staging buffer of an object
+		size_t staging;
+		// the only field of the span, or FIELD_COUNT if it holds several
+		size_t single;
+	};
+
+	struct Placement
+	{
+		size_t span;
+		// offset of the field inside its span
+		size_t offset;
+	};
+
+	const DMAHandler* DMA;
+	std::vector<Span> spans;
+	std::array<Placement, FIELD_COUNT> placements{};
+	// size of the spans of one object that go through the staging buffer
+	size_t stagingStride = 0;
+	std::vector<uint8_t> staging;
+	std::tuple<std::vector<typename Fields::type>...> columns;
+	size_t count = 0;
+
+	void layout(DWORD maxGap)
+	{
+		std::array<size_t, FIELD_COUNT> order;
+		for (size_t i = 0; i < FIELD_COUNT; i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+		for (const size_t field : order)
+		{
+			if (!spans.empty() && offsets[field] <= spans.back().offset + spans.back().size + maxGap)
+			{
+				Span& span = spans.back();
+				span.size = static_cast<DWORD>(std::max<ULONG64>(span.offset + span.size, offsets[field] + sizes[field]) - span.offset);
+				span.single = FIELD_COUNT;
+			}
+			else
+				spans.push_back(Span{ offsets[field], sizes[field], 0, field });
+
+			placements[field] = Placement{ spans.size() - 1, static_cast<size_t>(offsets[field] - spans.back().offset) };
+		}
+
+		for (auto& span : spans)
+		{
+			if (span.single != FIELD_COUNT)
+				continue;
+			span.staging = stagingStride;
+			stagingStride += span.size;
+		}
+	}
+
+	template <size_t I>
+	void prepareColumn(VMMDLL_SCATTER_HANDLE handle, std::span<const ULONG64> bases)
+	{
+		auto& column = std::get<I>(columns);
+		column.assign(bases.size(), {});
+
+		const Span& span = spans[placements[I].span];
+		if (span.single != I)
+			return;
+
+		for (size_t i = 0; i < bases.size(); i++)
+		{
+			if (bases[i])
+				DMA->queueScatterReadEx(handle, bases[i] + span.offset, &column[i], span.size);
+		}
+	}
+
+	template <size_t I>
+	void distributeColumn()
+	{
+		const Span& span = spans[placements[I].span];
+		if (span.single == I)
+			return;
+
+		auto& column = std::get<I>(columns);
+		const uint8_t* source = staging.data() + span.staging + placements[I].offset;
+		for (size_t i = 0; i < count; i++, source += stagingStride)
+			memcpy(&column[i], source, sizeof(column[i]));
+	}
+
+public:
+	/**
+	 * \param DMA the handler, has to outlive the reader
+	 * \param maxGap fields at most this many bytes apart are read as one span
+	 */
+	explicit BulkReader(const DMAHandler& DMA, DWORD maxGap = 64)
+		: DMA(&DMA)
+	{
+		layout(maxGap);
+	}
+
+	/**
+	 * \brief reads every field of every object in one scatter, null bases are skipped and their fields stay zero
+	 * \param bases base addresses of the objects
+	 * \return false if the execute failed
+	 */
+	bool read(std::span<const ULONG64> bases)
+	{
+		count = bases.size();
+
+		const auto handle = DMA->acquireScatterHandle();
+		if (!handle)
+			return false;
+
+		[&]<size_t... I>(std::index_sequence<I...>) { (prepareColumn<I>(handle, bases), ...); }(std::index_sequence_for<Fields...>{});
+
+		staging.assign(stagingStride * count, 0);
+		for (const auto& span : spans)
+		{
+			if (span.single != FIELD_COUNT)
+				continue;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (bases[i])
+					DMA->queueScatterReadEx(handle, bases[i] + span.offset, staging.data() + i * stagingStride + span.staging, span.size);
+			}
+		}
+
+		const bool result = DMA->executeScatterRead(handle);
+
+		[&]<size_t... I>(std::index_sequence<I...>) { (distributeColumn<I>(), ...); }(std::index_sequence_for<Fields...>{});
+		return result;
+	}
+
+	// Values of the I-th field, one per base passed to the last read
+	template <size_t I>
+	std::span<const typename std::tuple_element_t<I, std::tuple<Fields...>>::type> column() const
+	{
+		return std::get<I>(columns);
+	}
+
+	// Amount of objects of the last read
+	size_t size() const { return count; }
+
+	// Scatter entries a read issues per object
+	size_t entriesPerObject() const { return spans.size(); }
+};
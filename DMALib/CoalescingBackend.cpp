@@ -0,0 +1,269 @@
+#include "CoalescingBackend.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+CoalescingBackend::CoalescingBackend(std::shared_ptr<DMABackend> inner, const CoalescingConfig& config)
+	: inner(std::move(inner)), config(config)
+{
+	if (!this->config.pageSize)
+		this->config.pageSize = 0x1000;
+}
+
+CoalescingBackend::Stats CoalescingBackend::getStats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
+
+void CoalescingBackend::resetStats()
+{
+	std::lock_guard lock(mutex);
+	stats = {};
+}
+
+CoalescingBackend::Pending* CoalescingBackend::find(VMMDLL_SCATTER_HANDLE handle)
+{
+	// elements of an unordered_map never move, the pointer stays valid until the handle is closed
+	std::lock_guard lock(mutex);
+	const auto it = pending.find(handle);
+	return it == pending.end() ? nullptr : &it->second;
+}
+
+bool CoalescingBackend::canMerge(const Span& span, const Request& request) const
+{
+	const ULONG64 spanEnd = span.address + span.size;
+	const ULONG64 end = std::max(spanEnd, request.address + request.size);
+	if (!config.mergeAcrossPages && span.address / config.pageSize != (end - 1) / config.pageSize)
+		return false;
+
+	const ULONG64 lastPage = (spanEnd - 1) / config.pageSize;
+	const ULONG64 requestPage = request.address / config.pageSize;
+	const bool close = request.address <= spanEnd + config.maxGap;
+	if (requestPage <= lastPage)
+		return config.mergeWithinPage || close;
+
+	// never pulls in a page none of the reads is on
+	return requestPage == lastPage + 1 && close;
+}
+
+bool CoalescingBackend::prepareSpans(VMMDLL_SCATTER_HANDLE handle, Pending& state)
+{
+	std::vector<size_t> order(state.requests.size() - state.issued);
+	std::iota(order.begin(), order.end(), state.issued);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return state.requests[a].address < state.requests[b].address; });
+
+	const size_t first = state.spans.size();
+	ULONG64 requested = 0;
+	for (const size_t index : order)
+	{
+		Request& request = state.requests[index];
+		if (!request.size)
+			continue;
+
+		requested += request.size;
+		if (state.spans.size() > first && canMerge(state.spans.back(), request))
+		{
+			Span& span = state.spans.back();
+			span.size = static_cast<DWORD>(std::max(span.address + span.size, request.address + request.size) - span.address);
+		}
+		else
+			state.spans.push_back(Span{ request.address, request.size, nullptr, 0 });
+
+		request.span = state.spans.size() - 1;
+	}
+
+	size_t total = 0;
+	for (size_t i = first; i < state.spans.size(); i++)
+		total += state.spans[i].size;
+
+	auto& memory = state.memory.emplace_back(total);
+	size_t offset = 0;
+	bool result = true;
+	for (size_t i = first; i < state.spans.size(); i++)
+	{
+		Span& span = state.spans[i];
+		span.data = memory.data() + offset;
+		offset += span.size;
+
+		if (!inner->scatterPrepare(handle, span.address, span.size, span.data, &span.bytesRead))
+			result = false;
+	}
+
+	const size_t requests = state.requests.size() - state.issued;
+	const size_t spans = state.spans.size() - first;
+	state.issued = state.requests.size();
+
+	std::lock_guard lock(mutex);
+	stats.requests += requests;
+	stats.spans += spans;
+	stats.merged += requests - spans;
+	stats.bytesRequested += requested;
+	stats.bytesIssued += total;
+	return result;
+}
+
+const CoalescingBackend::Span* CoalescingBackend::findSpan(const Pending& state, ULONG64 address, DWORD size)
+{
+	// spans of one execute are sorted, later executes may hold fresher data for the same address
+	for (auto it = state.spans.rbegin(); it != state.spans.rend(); ++it)
+	{
+		if (address >= it->address && address + size <= it->address + it->size)
+			return &*it;
+	}
+	return nullptr;
+}
+
+void CoalescingBackend::distribute(Pending& state) const
+{
+	for (const Request& request : state.requests)
+	{
+		const Span* span = request.span < state.spans.size() ? &state.spans[request.span] : nullptr;
+		if (!span)
+		{
+			if (request.bytesRead)
+				*request.bytesRead = 0;
+			continue;
+		}
+
+		const DWORD offset = static_cast<DWORD>(request.address - span->address);
+		memcpy(request.buffer, span->data + offset, request.size);
+
+		// a span on a single page is read completely or not at all. Of a span over several pages that came back
+		// partially it is unknown which page failed, every read of it fails unless it is the whole span
+		if (request.bytesRead)
+		{
+			if (span->bytesRead >= span->size || span->size == request.size)
+				*request.bytesRead = std::min(request.size, span->bytesRead);
+			else if (span->address / config.pageSize == (span->address + span->size - 1) / config.pageSize)
+				*request.bytesRead = span->bytesRead ? request.size : 0;
+			else
+				*request.bytesRead = 0;
+		}
+	}
+}
+
+bool CoalescingBackend::isInitialized() const
+{
+	return inner && inner->isInitialized();
+}
+
+void CoalescingBackend::close()
+{
+	if (inner)
+		inner->close();
+}
+
+ULONG64 CoalescingBackend::getTargetFingerprint()
+{
+	return inner->getTargetFingerprint();
+}
+
+bool CoalescingBackend::getPidFromName(const char* processName, DWORD* pid)
+{
+	return inner->getPidFromName(processName, pid);
+}
+
+ULONG64 CoalescingBackend::getModuleBase(DWORD pid, const char* moduleName)
+{
+	return inner->getModuleBase(pid, moduleName);
+}
+
+bool CoalescingBackend::read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags)
+{
+	return inner->read(pid, address, buffer, size, bytesRead, flags);
+}
+
+bool CoalescingBackend::write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	return inner->write(pid, address, buffer, size);
+}
+
+bool CoalescingBackend::prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count)
+{
+	return inner->prefetchPages(pid, addresses, count);
+}
+
+VMMDLL_SCATTER_HANDLE CoalescingBackend::scatterInitialize(DWORD pid, DWORD flags)
+{
+	const VMMDLL_SCATTER_HANDLE handle = inner->scatterInitialize(pid, flags);
+	if (handle)
+	{
+		std::lock_guard lock(mutex);
+		pending[handle] = {};
+	}
+	return handle;
+}
+
+bool CoalescingBackend::scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	Pending* state = find(handle);
+	if (!state)
+		return inner->scatterPrepare(handle, address, size, buffer, bytesRead);
+
+	state->requests.push_back(Request{ address, size, buffer, bytesRead, SIZE_MAX });
+	return true;
+}
+
+bool CoalescingBackend::scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	return inner->scatterPrepareWrite(handle, address, buffer, size);
+}
+
+bool CoalescingBackend::scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle)
+{
+	Pending* state = find(handle);
+	if (!state)
+		return inner->scatterExecuteRead(handle);
+
+	const bool prepared = prepareSpans(handle, *state);
+	if (!inner->scatterExecuteRead(handle))
+		return false;
+
+	distribute(*state);
+	return prepared;
+}
+
+bool CoalescingBackend::scatterExecute(VMMDLL_SCATTER_HANDLE handle)
+{
+	Pending* state = find(handle);
+	if (!state)
+		return inner->scatterExecute(handle);
+
+	const bool prepared = prepareSpans(handle, *state);
+	if (!inner->scatterExecute(handle))
+		return false;
+
+	distribute(*state);
+	return prepared;
+}
+
+bool CoalescingBackend::scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	const Pending* state = find(handle);
+	const Span* span = state ? findSpan(*state, address, size) : nullptr;
+	if (!span)
+		return inner->scatterRead(handle, address, size, buffer, bytesRead);
+
+	memcpy(buffer, span->data + (address - span->address), size);
+	if (bytesRead)
+		*bytesRead = size;
+	return true;
+}
+
+bool CoalescingBackend::scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags)
+{
+	if (Pending* state = find(handle))
+		*state = {};
+	return inner->scatterClear(handle, pid, flags);
+}
+
+void CoalescingBackend::scatterClose(VMMDLL_SCATTER_HANDLE handle)
+{
+	{
+		std::lock_guard lock(mutex);
+		pending.erase(handle);
+	}
+	inner->scatterClose(handle);
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "DMABackend.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief Rules for merging the reads of a scatter handle
+ */
+struct CoalescingConfig
+{
+	// reads at most this many bytes apart are fetched as one span, the bytes in between are thrown away
+	DWORD maxGap = 64;
+	// reads on the same page are always merged, no matter the gap. The device fetches the whole page anyway
+	bool mergeWithinPage = true;
+	// a read at most maxGap bytes past a span that starts on the next page extends the span, both pages are read anyway.
+	// A page the device fails to read then fails every read of the span, without it spans never cross a page boundary
+	bool mergeAcrossPages = true;
+	ULONG64 pageSize = 0x1000;
+};
+
+/**
+ * \brief Backend that wraps another backend and merges the scatter reads of a handle before they are issued.
+ * Reads are collected on prepare, sorted by address on execute and overlapping, adjacent or close
+ * ranges are fetched as a single span, so hundreds of small field reads turn into one entry per page
+ * or per run of neighbouring pages. The results are copied back into the buffer of every read.
+ * Handles the wrapped backend created on its own are passed through untouched.
+ */
+class CoalescingBackend : public DMABackend
+{
+public:
+	struct Stats
+	{
+		// reads queued by the caller
+		ULONG64 requests = 0;
+		// reads issued to the wrapped backend
+		ULONG64 spans = 0;
+		// requests that were folded into the span of another one
+		ULONG64 merged = 0;
+		ULONG64 bytesRequested = 0;
+		// bytes of all spans, gaps included
+		ULONG64 bytesIssued = 0;
+	};
+
+private:
+	struct Request
+	{
+		ULONG64 address;
+		DWORD size;
+		PBYTE buffer;
+		DWORD* bytesRead;
+		// index of the span the request was merged into
+		size_t span;
+	};
+
+	struct Span
+	{
+		ULONG64 address;
+		DWORD size;
+		PBYTE data;
+		DWORD bytesRead;
+	};
+
+	struct Pending
+	{
+		std::vector<Request> requests;
+		// amount of requests already merged into spans, a handle may be executed again after more prepares
+		size_t issued = 0;
+		// sorted by address within every execute, a deque so the bytesRead pointers handed to the wrapped backend stay valid
+		std::deque<Span> spans;
+		// span memory, one block per execute so the pointers handed to the wrapped backend stay valid
+		std::vector<std::vector<BYTE>> memory;
+	};
+
+	std::shared_ptr<DMABackend> inner;
+	CoalescingConfig config;
+	std::unordered_map<VMMDLL_SCATTER_HANDLE, Pending> pending;
+	Stats stats{};
+	// guards pending and stats
+	mutable std::mutex mutex;
+
+	// Looks up the state of a handle created through this backend, nullptr for foreign handles
+	Pending* find(VMMDLL_SCATTER_HANDLE handle);
+
+	// Merges the requests queued since the last execute and prepares the spans on the wrapped backend
+	bool prepareSpans(VMMDLL_SCATTER_HANDLE handle, Pending& state);
+
+	// Copies the span memory into the buffers of the requests
+	void distribute(Pending& state) const;
+
+	// Latest span holding the whole range, nullptr if the range was not read through a span
+	static const Span* findSpan(const Pending& state, ULONG64 address, DWORD size);
+
+	bool canMerge(const Span& span, const Request& request) const;
+
+public:
+	CoalescingBackend(std::shared_ptr<DMABackend> inner, const CoalescingConfig& config = {});
+
+	const CoalescingConfig& getConfig() const { return config; }
+
+	Stats getStats() const;
+
+	void resetStats();
+
+	const char* name() const override { return "coalescing"; }
+
+	bool isInitialized() const override;
+
+	void close() override;
+
+	ULONG64 getTargetFingerprint() override;
+
+	bool getPidFromName(const char* processName, DWORD* pid) override;
+	ULONG64 getModuleBase(DWORD pid, const char* moduleName) override;
+
+	bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) override;
+	bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) override;
+
+	VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) override;
+	bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) override;
+	void scatterClose(VMMDLL_SCATTER_HANDLE handle) override;
+};
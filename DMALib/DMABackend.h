@@ -0,0 +1,54 @@
+#pragma once
+#include "DMACompat.h"
+
+// DMALib read flag, reads carrying it bypass the PageCacheBackend. Stripped before a read reaches MemProcFS
+#define DMALIB_FLAG_NOPAGECACHE                     0x100000000ull
+
+/**
+ * \brief Abstract memory backend every DMAHandler and DMAScatter call is routed through.
+ * The default implementation (VMMBackend) forwards to the VMMDLL_* functions of MemProcFS,
+ * other implementations serve memory without any device attached (e.g. FileBackend).
+ *
+ * All functions mirror their VMMDLL_* counterparts: same arguments, same VMMDLL_FLAG_* flags
+ * and same return semantics, so switching the backend does not change the behaviour of the library.
+ * Implementations take reads, writes and scatters on different handles from several threads at once,
+ * like MemProcFS does, every backend of the library guards its own state for that.
+ */
+class DMABackend
+{
+public:
+	virtual ~DMABackend() = default;
+
+	// Short name of the backend, used for logging
+	virtual const char* name() const = 0;
+
+	// Whether the backend is ready to serve requests
+	virtual bool isInitialized() const = 0;
+
+	// Closes the backend, every call afterwards fails
+	virtual void close() = 0;
+
+	// Identifies the running target, changes when it reboots. 0 if the backend can not tell, nothing is cached across launches then
+	virtual ULONG64 getTargetFingerprint() = 0;
+
+	// Process information
+	virtual bool getPidFromName(const char* processName, DWORD* pid) = 0;
+	virtual ULONG64 getModuleBase(DWORD pid, const char* moduleName) = 0;
+
+	// Plain memory access, see VMMDLL_MemReadEx and VMMDLL_MemWrite
+	virtual bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) = 0;
+	virtual bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) = 0;
+
+	// Reads pages into the data cache of the backend ahead of time, see VMMDLL_MemPrefetchPages. Backends without a cache do nothing
+	virtual bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) = 0;
+
+	// Scatter access, see VMMDLL_Scatter_*. The returned handle is only valid for the backend that created it.
+	virtual VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) = 0;
+	virtual bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) = 0;
+	virtual bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) = 0;
+	virtual bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) = 0;
+	virtual bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) = 0;
+	virtual bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) = 0;
+	virtual bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) = 0;
+	virtual void scatterClose(VMMDLL_SCATTER_HANDLE handle) = 0;
+};
@@ -0,0 +1,142 @@
+#pragma once
+// Isolates the Windows types and functions DMALib uses, so the library also builds on Linux
+// against the Linux builds of MemProcFS and LeechCore.
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <vmmdll.h>
+
+#else
+
+#ifndef LINUX
+#define LINUX
+#endif
+
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dlfcn.h>
+
+// vmmdll.h and leechcore.h define the basic Windows types (DWORD, ULONG64, PBYTE, ...) for LINUX
+#include <vmmdll.h>
+
+typedef int32_t                             LONG;
+typedef uint64_t                            DWORD64, ULONGLONG;
+typedef uint8_t                             BOOLEAN;
+
+#ifndef TRUE
+#define TRUE                                1
+#endif
+#ifndef FALSE
+#define FALSE                               0
+#endif
+
+#define IMAGE_DOS_SIGNATURE                 0x5A4D
+#define IMAGE_NT_SIGNATURE                  0x00004550
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES    16
+#define IMAGE_SCN_CNT_CODE                  0x00000020
+#define IMAGE_SCN_MEM_EXECUTE               0x20000000
+#define IMAGE_SCN_MEM_READ                  0x40000000
+#define IMAGE_SCN_MEM_WRITE                 0x80000000
+
+typedef struct _IMAGE_DOS_HEADER {
+	WORD   e_magic;
+	WORD   e_cblp;
+	WORD   e_cp;
+	WORD   e_crlc;
+	WORD   e_cparhdr;
+	WORD   e_minalloc;
+	WORD   e_maxalloc;
+	WORD   e_ss;
+	WORD   e_sp;
+	WORD   e_csum;
+	WORD   e_ip;
+	WORD   e_cs;
+	WORD   e_lfarlc;
+	WORD   e_ovno;
+	WORD   e_res[4];
+	WORD   e_oemid;
+	WORD   e_oeminfo;
+	WORD   e_res2[10];
+	LONG   e_lfanew;
+} IMAGE_DOS_HEADER, * PIMAGE_DOS_HEADER;
+
+typedef struct _IMAGE_FILE_HEADER {
+	WORD    Machine;
+	WORD    NumberOfSections;
+	DWORD   TimeDateStamp;
+	DWORD   PointerToSymbolTable;
+	DWORD   NumberOfSymbols;
+	WORD    SizeOfOptionalHeader;
+	WORD    Characteristics;
+} IMAGE_FILE_HEADER, * PIMAGE_FILE_HEADER;
+
+typedef struct _IMAGE_OPTIONAL_HEADER64 {
+	WORD        Magic;
+	BYTE        MajorLinkerVersion;
+	BYTE        MinorLinkerVersion;
+	DWORD       SizeOfCode;
+	DWORD       SizeOfInitializedData;
+	DWORD       SizeOfUninitializedData;
+	DWORD       AddressOfEntryPoint;
+	DWORD       BaseOfCode;
+	ULONGLONG   ImageBase;
+	DWORD       SectionAlignment;
+	DWORD       FileAlignment;
+	WORD        MajorOperatingSystemVersion;
+	WORD        MinorOperatingSystemVersion;
+	WORD        MajorImageVersion;
+	WORD        MinorImageVersion;
+	WORD        MajorSubsystemVersion;
+	WORD        MinorSubsystemVersion;
+	DWORD       Win32VersionValue;
+	DWORD       SizeOfImage;
+	DWORD       SizeOfHeaders;
+	DWORD       CheckSum;
+	WORD        Subsystem;
+	WORD        DllCharacteristics;
+	ULONGLONG   SizeOfStackReserve;
+	ULONGLONG   SizeOfStackCommit;
+	ULONGLONG   SizeOfHeapReserve;
+	ULONGLONG   SizeOfHeapCommit;
+	DWORD       LoaderFlags;
+	DWORD       NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER64, * PIMAGE_OPTIONAL_HEADER64;
+
+typedef struct _IMAGE_NT_HEADERS64 {
+	DWORD                   Signature;
+	IMAGE_FILE_HEADER       FileHeader;
+	IMAGE_OPTIONAL_HEADER64 OptionalHeader;
+} IMAGE_NT_HEADERS64, * PIMAGE_NT_HEADERS64, IMAGE_NT_HEADERS, * PIMAGE_NT_HEADERS;
+
+static_assert(sizeof(IMAGE_DOS_HEADER) == 64, "IMAGE_DOS_HEADER layout mismatch");
+static_assert(sizeof(IMAGE_NT_HEADERS64) == 264, "IMAGE_NT_HEADERS64 layout mismatch");
+
+inline HMODULE LoadLibraryA(const char* fileName)
+{
+	return dlopen(fileName, RTLD_NOW | RTLD_GLOBAL);
+}
+
+inline void DebugBreak()
+{
+	raise(SIGTRAP);
+}
+
+inline int localtime_s(std::tm* tm, const time_t* time)
+{
+	return localtime_r(time, tm) ? 0 : errno;
+}
+
+inline int vsprintf_s(char* buffer, size_t size, const char* format, va_list args)
+{
+	return vsnprintf(buffer, size, format, args);
+}
+
+#endif /* _WIN32 */
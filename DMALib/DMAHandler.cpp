@@ -1,11 +1,20 @@
 // ReSharper disable CppCStyleCast
 #include "DMAHandler.h"
+#include "TargetCacheBackend.h"
+#if DMALIB_WITH_VMM
+#include "VMMBackend.h"
+#endif
 
-#include <fstream>
+#include <algorithm>
+#include <cctype>
 #include <chrono>
-#include <leechcore.h>
-#include <unordered_map>
-#include <filesystem>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
 
 
 void DMAHandler::log(const char* fmt, ...)
@@ -29,7 +38,7 @@ void DMAHandler::log(const char* fmt, ...)
 
 void DMAHandler::assertNoInit() const
 {
-	if (!DMA_HANDLE || !PROCESS_INITIALIZED)
+	if (!backend || !backend->isInitialized() || !PROCESS_INITIALIZED)
 	{
 		log("DMA or process not inizialized!");
 		throw new std::string("DMA not inizialized!");
@@ -37,86 +46,71 @@ void DMAHandler::assertNoInit() const
 
 }
 
-void DMAHandler::retrieveScatter(VMMDLL_SCATTER_HANDLE handle, void* buffer, void* target, SIZE_T size)
+void DMAHandler::retrieveScatter(VMMDLL_SCATTER_HANDLE handle, void* buffer, void* target, SIZE_T size) const
 {
 	if (!handle) {
 		log("Invalid handle!");
 		return;
 	}
 	DWORD bytesRead = 0;
-	if (!VMMDLL_Scatter_Read(handle, reinterpret_cast<ULONG64>(target), size, static_cast<PBYTE>(buffer), &bytesRead))
+	if (!backend->scatterRead(handle, reinterpret_cast<ULONG64>(target), static_cast<DWORD>(size), static_cast<PBYTE>(buffer), &bytesRead))
 		log("Scatter read for %p failed partly or full! Bytes written: %d/%d", target, bytesRead, size);
 }
 
-DMAHandler::DMAHandler(const wchar_t* wname, bool memMap)
+DMAHandler::DMAHandler(const wchar_t* wname, bool memMap, const char* cacheFile)
+	: backend(connect(memMap, cacheFile))
 {
-	if (!DMA_HANDLE)
-	{
-		log("loading libraries...");
-		modules.VMM = LoadLibraryA("vmm.dll");
-		modules.FTD3XX = LoadLibraryA("FTD3XX.dll");
-		modules.LEECHCORE = LoadLibraryA("leechcore.dll");
-
-		if (!modules.VMM || !modules.FTD3XX || !modules.LEECHCORE)
-		{
-			log("ERROR: could not load a library:");
-			log("vmm: %p\n", modules.VMM);
-			log("ftd: %p\n", modules.FTD3XX);
-			log("leech: %p\n", modules.LEECHCORE);
-		}
-
-		log("inizializing...");
+	if (!backend || !backend->isInitialized())
+		return;
 
-		LPSTR args[] = { (LPSTR)"", (LPSTR)"-device", (LPSTR)"fpga", (LPSTR)"-v", (LPSTR)"", (LPSTR)""};
-		DWORD argc = 4;
+	attachProcess(wname);
+}
 
-		if (memMap)
-		{
-			log("dumping memory map to file...");
-			if (!DumpMemoryMap())
-			{
-				log("ERROR: Could not dump memory map!");
-				log("Defaulting to no memory map!");
-			}
-			else
-			{
-				log("Dumped memory map!");
-				//Get Path to executable
-				char buffer[MAX_PATH];
-				GetModuleFileNameA(nullptr, buffer, MAX_PATH);
-				//Remove the executable name
-				std::string directoryPath = std::filesystem::path(buffer).parent_path().string();
-				directoryPath += "\\mmap.txt";
-
-				//Add the memory map to the arguments and increase arg count.
-				args[argc++] = const_cast<LPSTR>("-memmap");
-				args[argc++] = const_cast<LPSTR>(directoryPath.c_str());
-			}
-		}
-		DMA_HANDLE = VMMDLL_Initialize(argc, args);
-		if (!DMA_HANDLE)
+std::shared_ptr<DMABackend> DMAHandler::connect(bool memMap, const char* cacheFile)
+{
+	std::lock_guard lock(DMA_BACKEND_MUTEX);
+#if DMALIB_WITH_VMM
+	if (!DMA_BACKEND || !DMA_BACKEND->isInitialized())
+	{
+		if (cacheFile)
 		{
-			log("ERROR: Initialization failed! Is the DMA in use or disconnected?");
-			return;
+			const auto cache = std::make_shared<TargetCache>(cacheFile);
+			DMA_BACKEND = std::make_shared<TargetCacheBackend>(std::make_shared<VMMBackend>(memMap, cache), cache);
 		}
+		else
+			DMA_BACKEND = std::make_shared<VMMBackend>(memMap);
+	}
+#else
+	(void)memMap;
+	(void)cacheFile;
+	if (!DMA_BACKEND)
+		log("ERROR: DMALib was built without MemProcFS, pass a backend to the constructor!");
+#endif
 
-		ULONG64 FPGA_ID, DEVICE_ID;
-
-		VMMDLL_ConfigGet(DMA_HANDLE, LC_OPT_FPGA_FPGA_ID, &FPGA_ID);
-		VMMDLL_ConfigGet(DMA_HANDLE, LC_OPT_FPGA_DEVICE_ID, &DEVICE_ID);
+	return DMA_BACKEND;
+}
 
-		log("FPGA ID: %llu", FPGA_ID);
-		log("DEVICE ID: %llu", DEVICE_ID);
-		log("success!");
+DMAHandler::DMAHandler(const wchar_t* wname, std::shared_ptr<DMABackend> backend)
+	: backend(std::move(backend))
+{
+	if (!this->backend || !this->backend->isInitialized())
+	{
+		log("ERROR: backend is not initialized!");
+		return;
 	}
 
-	// Convert the wide string to a standard string because VMMDLL_PidGetFromName expects LPSTR.
+	attachProcess(wname);
+}
+
+void DMAHandler::attachProcess(const wchar_t* wname)
+{
+	// Convert the wide string to a standard string because the backends expect narrow names.
 	std::wstring ws(wname);
 	const std::string str(ws.begin(), ws.end());
 
 	processInfo.name = str;
 	processInfo.wname = wname;
-	if (!VMMDLL_PidGetFromName(DMA_HANDLE, const_cast<char*>(processInfo.name.c_str()), &processInfo.pid))
+	if (!backend->getPidFromName(processInfo.name.c_str(), &processInfo.pid))
 	{
 		log("WARN: Process with name %s not found!", processInfo.name.c_str());
 	}
@@ -124,43 +118,62 @@ DMAHandler::DMAHandler(const wchar_t* wname, bool memMap)
 		PROCESS_INITIALIZED = TRUE;
 }
 
-bool DMAHandler::DumpMemoryMap()
-{
-	LPSTR args[] = { (LPSTR)"", (LPSTR)"-device", (LPSTR)"fpga", (LPSTR)"-v" };
-	if (const VMM_HANDLE handle = VMMDLL_Initialize(3, args)) {
-		PVMMDLL_MAP_PHYSMEM pPhysMemMap = nullptr;
-		if (VMMDLL_Map_GetPhysMem(handle, &pPhysMemMap)) {
-			if (pPhysMemMap->dwVersion != VMMDLL_MAP_PHYSMEM_VERSION) {
-				log("Invalid VMM Map Version\n");
-				VMMDLL_MemFree(pPhysMemMap);
-				VMMDLL_Close(handle);
-				return false;
-			}
-
-			//Dump map to file
-			std::stringstream sb;
-			for (DWORD i = 0; i < pPhysMemMap->cMap; i++) {
-				sb << std::setfill('0') << std::setw(4) << i << "  " << std::hex << pPhysMemMap->pMap[i].pa << "  -  " << (pPhysMemMap->pMap[i].pa + pPhysMemMap->pMap[i].cb - 1) << "  ->  " << pPhysMemMap->pMap[i].pa << std::endl;
-			}
-			std::ofstream nFile("mmap.txt");
-			nFile << sb.str();
-			nFile.close();
-
-			VMMDLL_MemFree(pPhysMemMap);
-			log("Successfully dumped memory map to file!");
-			//Little sleep to make sure it's written to file.
-			Sleep(3000);
-		}
-		VMMDLL_Close(handle);
-		return true;
-	}
-	else
+std::shared_ptr<CoalescingBackend> DMAHandler::enableScatterCoalescing(const CoalescingConfig& config)
+{
+	if (const auto coalescing = std::dynamic_pointer_cast<CoalescingBackend>(backend))
+		return coalescing;
+
+	auto coalescing = std::make_shared<CoalescingBackend>(backend, config);
+	backend = coalescing;
+
+	// pooled handles belong to the old backend and would skip the coalescing. Outstanding leases keep the old pool alive, it closes its handles once they are back
+	std::lock_guard lock(scatterPoolMutex);
+	scatterPool.reset();
+	return coalescing;
+}
+
+std::shared_ptr<PageCacheBackend> DMAHandler::enableReadCache(const PageCacheConfig& config)
+{
+	if (pageCache)
+		return pageCache;
+
+	pageCache = std::make_shared<PageCacheBackend>(backend, config);
+	backend = pageCache;
+
+	std::lock_guard lock(scatterPoolMutex);
+	scatterPool.reset();
+	return pageCache;
+}
+
+bool DMAHandler::setModuleCacheTTL(const std::string& moduleName, ULONG64 ttl)
+{
+	assertNoInit();
+
+	if (!pageCache)
 		return false;
+
+	std::lock_guard lock(scanMutex);
+	const ModuleImage* module = loadModule(moduleName);
+	if (!module)
+		return false;
+
+	// the image ends with its last section, the headers come before the first one
+	ULONG64 end = module->base + 0x1000;
+	for (const auto& section : module->sections)
+		end = std::max<ULONG64>(end, section.address + section.size);
+
+	pageCache->setRegionTTL(processInfo.pid, module->base, end - module->base, ttl);
+	return true;
 }
 
 bool DMAHandler::isInitialized() const
 {
-	return DMA_HANDLE && PROCESS_INITIALIZED;
+	return backend && backend->isInitialized() && PROCESS_INITIALIZED;
+}
+
+DMABackend* DMAHandler::getBackend() const
+{
+	return backend.get();
 }
 
 DWORD DMAHandler::getPID() const
@@ -171,147 +184,363 @@ DWORD DMAHandler::getPID() const
 
 ULONG64 DMAHandler::getBaseAddress()
 {
+	// racing first calls both look it up, they find the same base
 	if (!processInfo.base)
-		processInfo.base = VMMDLL_ProcessGetModuleBase(DMA_HANDLE, processInfo.pid, const_cast<LPWSTR>(processInfo.wname));
+		processInfo.base = backend->getModuleBase(processInfo.pid, processInfo.name.c_str());
 
 	return processInfo.base;
 }
 
-void DMAHandler::read(const ULONG64 address, const ULONG64 buffer, const SIZE_T size) const
+void DMAHandler::setReadPolicy(const ReadPolicy& policy)
+{
+	const bool scatterFlagsChanged = policy.scatterFlags != readPolicy.scatterFlags;
+	readPolicy = policy;
+
+	if (!scatterFlagsChanged)
+		return;
+
+	// pooled handles were created with the old flags, the leases still out keep the old pool alive
+	std::lock_guard lock(scatterPoolMutex);
+	scatterPool.reset();
+}
+
+const ReadPolicy& DMAHandler::getReadPolicy() const
+{
+	return readPolicy;
+}
+
+bool DMAHandler::read(const ULONG64 address, const ULONG64 buffer, const SIZE_T size) const
+{
+	return read(address, buffer, size, readPolicy);
+}
+
+bool DMAHandler::read(const ULONG64 address, const ULONG64 buffer, const SIZE_T size, const ReadPolicy& policy) const
 {
 	assertNoInit();
 	DWORD dwBytesRead = 0;
 
 #if COUNT_TOTAL_READSIZE
-	readSize += size;
+	readSize.add(size);
 #endif
 
-	VMMDLL_MemReadEx(DMA_HANDLE, processInfo.pid, address, reinterpret_cast<PBYTE>(buffer), size, &dwBytesRead, VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_NOPAGING | VMMDLL_FLAG_ZEROPAD_ON_FAIL | VMMDLL_FLAG_NOPAGING_IO);
+	const bool success = backend->read(processInfo.pid, address, reinterpret_cast<PBYTE>(buffer), static_cast<DWORD>(size), &dwBytesRead, policy.readFlags());
 
 	if (dwBytesRead != size)
 		log("Didnt read all bytes requested! Only read %llu/%llu bytes!", dwBytesRead, size);
+	return success;
 }
 
 bool DMAHandler::write(const ULONG64 address, const ULONG64 buffer, const SIZE_T size) const
 {
 	assertNoInit();
-	return VMMDLL_MemWrite(DMA_HANDLE, processInfo.pid, address, reinterpret_cast<PBYTE>(buffer), size);
+	return backend->write(processInfo.pid, address, reinterpret_cast<PBYTE>(buffer), static_cast<DWORD>(size));
 }
 
-ULONG64 DMAHandler::patternScan(const char* pattern, const std::string& mask, bool returnCSOffset)
+DMAHandler::ModuleImage* DMAHandler::loadModule(const std::string& moduleName)
 {
-	assertNoInit();
-	//technically not write if you use the same pattern but once with RVA flag and once without
-	//but i dont see any case where both results are needed so i cba
-	static std::unordered_map<const char*, uint64_t> patternMap{};
-
-	static std::vector<IMAGE_SECTION_HEADER> sectionHeaders;
-	static char* textBuff = nullptr;
-	static bool init = false;
-	static DWORD virtualSize = 0;
-	static uint64_t vaStart = 0;
-
-	auto CheckMask = [](const char* Base, const char* Pattern, const char* Mask) {
-		for (; *Mask; ++Base, ++Pattern, ++Mask) {
-			if (*Mask == 'x' && *Base != *Pattern) {
-				return false;
-			}
-		}
-		return true;
-	};
+	std::string name = moduleName.empty() ? processInfo.name : moduleName;
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
 
-	if (patternMap.contains(pattern))
-		return patternMap[pattern];
+	auto& cached = moduleImages[{ processInfo.pid, name }];
+	if (cached)
+		return cached.get();
 
-	if (!init)
+	const ULONG64 base = moduleName.empty() ? getBaseAddress() : backend->getModuleBase(processInfo.pid, moduleName.c_str());
+	if (!base)
 	{
-		init = true;
+		log("WARN: Module %s not found!", name.c_str());
+		return nullptr;
+	}
+
+	const IMAGE_DOS_HEADER dosHeader = read<IMAGE_DOS_HEADER>(base);
+
+	if (dosHeader.e_magic != IMAGE_DOS_SIGNATURE)
+		throw std::runtime_error("dosHeader.e_magic invalid!");
 
-		static IMAGE_DOS_HEADER dosHeader;
-		static IMAGE_NT_HEADERS ntHeaders;
+	const IMAGE_NT_HEADERS ntHeaders = read<IMAGE_NT_HEADERS>(base + dosHeader.e_lfanew);
 
-		dosHeader = read<IMAGE_DOS_HEADER>(getBaseAddress());
+	if (ntHeaders.Signature != IMAGE_NT_SIGNATURE)
+		throw std::runtime_error("ntHeaders.Signature invalid!");
 
+	std::vector<IMAGE_SECTION_HEADER> sectionHeaders(ntHeaders.FileHeader.NumberOfSections);
+	const DWORD sectionHeadersSize = ntHeaders.FileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER);
 
-		if (dosHeader.e_magic != IMAGE_DOS_SIGNATURE)
-			throw std::runtime_error("dosHeader.e_magic invalid!");
+	//the section table follows the optional header
+	const ULONG64 sectionTable = base + dosHeader.e_lfanew + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) + ntHeaders.FileHeader.SizeOfOptionalHeader;
+	read(sectionTable, reinterpret_cast<DWORD64>(sectionHeaders.data()), sectionHeadersSize);
 
-		ntHeaders = read<IMAGE_NT_HEADERS>(getBaseAddress() + dosHeader.e_lfanew);
+	auto module = std::make_unique<ModuleImage>();
+	module->base = base;
 
-		if (ntHeaders.Signature != IMAGE_NT_SIGNATURE)
-			throw std::runtime_error("ntHeaders.Signature invalid!");
+	size_t arenaSize = 0;
+	for (const auto& header : sectionHeaders) {
+		ModuleImage::Section section{};
+		section.name.assign(reinterpret_cast<const char*>(header.Name), strnlen(reinterpret_cast<const char*>(header.Name), IMAGE_SIZEOF_SHORT_NAME));
+		section.characteristics = header.Characteristics;
+		section.address = base + header.VirtualAddress;
+		section.offset = arenaSize;
+		section.size = header.Misc.VirtualSize;
+		arenaSize += section.size;
+		module->sections.push_back(std::move(section));
+	}
+
+	//sections of a PE can not be larger than 4GB in total, anything above is a broken header
+	if (arenaSize > 0xFFFFFFFFull)
+		throw std::runtime_error("section sizes invalid!");
 
-		const DWORD sectionHeadersSize = ntHeaders.FileHeader.NumberOfSections * sizeof(IMAGE_SECTION_HEADER);
-		sectionHeaders.resize(ntHeaders.FileHeader.NumberOfSections);
+	module->arena.reset(new uint8_t[arenaSize]);
 
-		read(getBaseAddress() + dosHeader.e_lfanew + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER), reinterpret_cast<DWORD64>(sectionHeaders.data()), sectionHeadersSize);
+	cached = std::move(module);
+	return cached.get();
+}
 
+std::vector<ScanRegion> DMAHandler::scanRegions(ModuleImage& module)
+{
+	std::vector<ScanRegion> regions;
+	for (auto& section : module.sections)
+	{
+		const bool selected = scanSectionNames.empty()
+			? (section.characteristics & IMAGE_SCN_MEM_EXECUTE) != 0
+			: std::find(scanSectionNames.begin(), scanSectionNames.end(), section.name) != scanSectionNames.end();
 
-		for (const auto& section : sectionHeaders) {
-			std::string sectionName(reinterpret_cast<const char*>(section.Name));
-			if (sectionName == ".text") {
-				textBuff = static_cast<char*>(calloc(section.Misc.VirtualSize, 1));
-				read(getBaseAddress() + section.VirtualAddress, reinterpret_cast<DWORD64>(textBuff), section.Misc.VirtualSize);
-				virtualSize = section.Misc.VirtualSize;
-				vaStart = getBaseAddress() + section.VirtualAddress;
-			}
+		if (!selected || !section.size)
+			continue;
+
+		uint8_t* image = module.arena.get() + section.offset;
+		if (!section.loaded)
+		{
+			read(section.address, reinterpret_cast<DWORD64>(image), section.size);
+			section.loaded = true;
 		}
+		regions.push_back(ScanRegion{ image, section.size, section.address });
 	}
 
+	if (regions.empty())
+		log("WARN: no section to pattern scan!");
 
-	const int length = virtualSize - mask.length();
+	return regions;
+}
 
-	for (int i = 0; i <= length; ++i)
-	{
-		char* addr = &textBuff[i];
+ULONG64 DMAHandler::resolveCSOffset(const ScanRegion& region, size_t offset)
+{
+	if (offset + 7 > region.size)
+		return 0;
 
-		if (!CheckMask(addr, pattern, mask.c_str()))
-			continue;
+	int displacement;
+	memcpy(&displacement, region.data + offset + 3, sizeof(displacement));
+	return region.address + offset + displacement + 7;
+}
+
+void DMAHandler::setScanSections(std::vector<std::string> names)
+{
+	std::lock_guard lock(scanMutex);
+	scanSectionNames = std::move(names);
+	patternCache.clear();
+}
+
+ULONG64 DMAHandler::patternScan(const char* pattern, const std::string& mask, bool returnCSOffset, const std::string& moduleName)
+{
+	assertNoInit();
+
+	std::lock_guard lock(scanMutex);
+	PatternKey key{ moduleName, Signature::fromMask(pattern, mask), returnCSOffset };
+	if (const auto it = patternCache.find(key); it != patternCache.end())
+		return it->second;
+
+	ModuleImage* module = loadModule(moduleName);
+	if (!module)
+		return 0;
 
-		const uint64_t uAddr = reinterpret_cast<uint64_t>(addr);
+	const auto regions = scanRegions(*module);
 
-		if (returnCSOffset)
+	const ScanMatch match = PatternScanner::findLowest(regions, key.signature, ThreadPool::shared());
+	if (!match.found())
+		return 0;
+
+	const auto res = returnCSOffset ? resolveCSOffset(regions[match.region], match.offset) : match.address;
+	patternCache.emplace(std::move(key), res);
+	return res;
+}
+
+std::vector<ULONG64> DMAHandler::patternScan(const std::vector<std::string>& signatures, bool returnCSOffset, const std::string& moduleName)
+{
+	assertNoInit();
+
+	std::lock_guard lock(scanMutex);
+	std::vector<ULONG64> result(signatures.size(), 0);
+
+	// only the signatures without a cached result get scanned
+	std::vector<PatternKey> keys;
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < signatures.size(); i++)
+	{
+		PatternKey key{ moduleName, Signature::fromIDA(signatures[i]), returnCSOffset };
+		if (!key.signature.size())
 		{
-			const auto res = vaStart + i + *reinterpret_cast<int*>(uAddr + 3) + 7;
-			patternMap.insert(std::pair(pattern, res));
-			return res;
+			log("WARN: invalid signature \"%s\"", signatures[i].c_str());
+			continue;
 		}
 
-		const auto res = vaStart + i;
-		patternMap.insert(std::pair(pattern, res));
-		return res;
+		if (const auto it = patternCache.find(key); it != patternCache.end())
+		{
+			result[i] = it->second;
+			continue;
+		}
+
+		keys.push_back(std::move(key));
+		indices.push_back(i);
+	}
+
+	if (keys.empty())
+		return result;
+
+	ModuleImage* module = loadModule(moduleName);
+	if (!module)
+		return result;
+
+	const auto regions = scanRegions(*module);
+
+	std::vector<Signature> compiled;
+	compiled.reserve(keys.size());
+	for (const auto& key : keys)
+		compiled.push_back(key.signature);
+
+	const PatternScanner scanner(std::move(compiled));
+	const auto matches = scanner.scanLowest(regions, ThreadPool::shared());
+
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		if (!matches[i].found())
+			continue;
+
+		const ULONG64 address = returnCSOffset ? resolveCSOffset(regions[matches[i].region], matches[i].offset) : matches[i].address;
+		result[indices[i]] = address;
+		patternCache.emplace(std::move(keys[i]), address);
 	}
-	return 0;
+	return result;
+}
+
+MatchRange DMAHandler::patternScanAll(const Signature& signature, const std::string& moduleName)
+{
+	assertNoInit();
+
+	// the images stay where they are once read, the range reads them after the lock is gone
+	std::lock_guard lock(scanMutex);
+	ModuleImage* module = loadModule(moduleName);
+	if (!module)
+		return MatchRange({}, signature);
+
+	return MatchRange(scanRegions(*module), signature);
 }
 
 void DMAHandler::queueScatterReadEx(VMMDLL_SCATTER_HANDLE handle, uint64_t addr, void* bffr, size_t size) const
 {
 	assertNoInit();
 
-	DWORD memoryPrepared = NULL;
-	if (!VMMDLL_Scatter_PrepareEx(handle, addr, size, static_cast<PBYTE>(bffr), &memoryPrepared)) {
+	//pcbRead is written on execute, so no pointer to a local here
+	if (!backend->scatterPrepare(handle, addr, static_cast<DWORD>(size), static_cast<PBYTE>(bffr), nullptr)) {
 		log("failed to prepare scatter read at 0x % p\n", addr);
 	}
 }
 
-void DMAHandler::executeScatterRead(VMMDLL_SCATTER_HANDLE handle) const
+bool DMAHandler::runScatterRead(VMMDLL_SCATTER_HANDLE handle) const
 {
-	assertNoInit();
-
-	if (!VMMDLL_Scatter_ExecuteRead(handle)) {
+	const bool result = backend->scatterExecuteRead(handle);
+	if (!result) {
 		log("failed to Execute Scatter Read\n");
 	}
-	//Clear after using it
-	if (!VMMDLL_Scatter_Clear(handle, processInfo.pid, NULL)) {
+	//Clear after using it, clearing resets the flags of the handle as well
+	if (!backend->scatterClear(handle, processInfo.pid, readPolicy.scatterFlags)) {
 		log("failed to clear read Scatter\n");
 	}
+	return result;
+}
+
+bool DMAHandler::executeScatterRead(VMMDLL_SCATTER_HANDLE handle) const
+{
+	assertNoInit();
+
+	return runScatterRead(handle);
+}
+
+ThreadPool& DMAHandler::getIOThread() const
+{
+	std::call_once(ioThreadOnce, [this] { ioThread = std::make_unique<ThreadPool>(1); });
+	return *ioThread;
+}
+
+void DMAHandler::prefetch(std::span<const ULONG64> addresses) const
+{
+	assertNoInit();
+
+	if (addresses.empty())
+		return;
+
+	{
+		std::lock_guard lock(prefetchMutex);
+		for (const ULONG64 address : addresses)
+			prefetchPending.push_back(address & ~0xFFFull);
+
+		if (prefetchScheduled)
+			return;
+		prefetchScheduled = true;
+	}
+
+	std::call_once(prefetchThreadOnce, [this] { prefetchThread = std::make_unique<ThreadPool>(1); });
+	prefetchThread->submit([this] { runPrefetch(); });
+}
+
+void DMAHandler::prefetch(ULONG64 address, SIZE_T size) const
+{
+	if (!size)
+		return;
+
+	std::vector<ULONG64> pages;
+	for (ULONG64 page = address & ~0xFFFull; page < address + size; page += 0x1000)
+		pages.push_back(page);
+	prefetch(pages);
+}
+
+void DMAHandler::runPrefetch() const
+{
+	std::vector<ULONG64> pages;
+	{
+		std::lock_guard lock(prefetchMutex);
+		pages.swap(prefetchPending);
+		prefetchScheduled = false;
+	}
+
+	std::sort(pages.begin(), pages.end());
+	pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+	if (!backend->prefetchPages(processInfo.pid, pages.data(), static_cast<DWORD>(pages.size())))
+		log("failed to prefetch %zu pages\n", pages.size());
+}
+
+std::future<bool> DMAHandler::executeScatterReadAsync(VMMDLL_SCATTER_HANDLE handle) const
+{
+	assertNoInit();
+
+	return getIOThread().submit([this, handle] { return runScatterRead(handle); });
+}
+
+void DMAHandler::executeScatterReadAsync(VMMDLL_SCATTER_HANDLE handle, std::function<void(bool)> onComplete) const
+{
+	assertNoInit();
+
+	getIOThread().submit([this, handle, onComplete = std::move(onComplete)]
+	{
+		const bool result = runScatterRead(handle);
+		if (onComplete)
+			onComplete(result);
+	});
 }
 
 void DMAHandler::queueScatterWriteEx(VMMDLL_SCATTER_HANDLE handle, uint64_t addr, void* bffr, size_t size) const
 {
 	assertNoInit();
 
-	if (!VMMDLL_Scatter_PrepareWrite(handle, addr, static_cast<PBYTE>(bffr), size)) {
+	if (!backend->scatterPrepareWrite(handle, addr, static_cast<PBYTE>(bffr), static_cast<DWORD>(size))) {
 		log("failed to prepare scatter write at 0x%p\n", addr);
 	}
 }
@@ -320,11 +549,11 @@ void DMAHandler::executeScatterWrite(VMMDLL_SCATTER_HANDLE handle) const
 {
 	assertNoInit();
 
-	if (!VMMDLL_Scatter_Execute(handle)) {
+	if (!backend->scatterExecute(handle)) {
 		log("failed to Execute Scatter write\n");
 	}
-	//Clear after using it
-	if (!VMMDLL_Scatter_Clear(handle, processInfo.pid, NULL)) {
+	//Clear after using it, clearing resets the flags of the handle as well
+	if (!backend->scatterClear(handle, processInfo.pid, readPolicy.scatterFlags)) {
 		log("failed to clear write Scatter\n");
 	}
 }
@@ -333,7 +562,7 @@ VMMDLL_SCATTER_HANDLE DMAHandler::createScatterHandle() const
 {
 	assertNoInit();
 
-	const VMMDLL_SCATTER_HANDLE ScatterHandle = VMMDLL_Scatter_Initialize(DMA_HANDLE, processInfo.pid, VMMDLL_FLAG_NOCACHE);
+	const VMMDLL_SCATTER_HANDLE ScatterHandle = backend->scatterInitialize(processInfo.pid, readPolicy.scatterFlags);
 	if (!ScatterHandle) log("failed to create scatter handle\n");
 	return ScatterHandle;
 }
@@ -342,29 +571,50 @@ void DMAHandler::closeScatterHandle(VMMDLL_SCATTER_HANDLE& handle) const
 {
 	assertNoInit();
 
-	VMMDLL_Scatter_CloseHandle(handle);
+	backend->scatterClose(handle);
 
 	handle = nullptr;
 }
 
+std::shared_ptr<ScatterHandlePool> DMAHandler::getScatterPool() const
+{
+	assertNoInit();
+
+	std::lock_guard lock(scatterPoolMutex);
+	if (!scatterPool)
+		scatterPool = std::make_shared<ScatterHandlePool>(backend, processInfo.pid, 2, 16, readPolicy.scatterFlags);
+	return scatterPool;
+}
+
+ScatterHandlePool::Lease DMAHandler::acquireScatterHandle() const
+{
+	auto lease = getScatterPool()->acquire();
+	if (!lease) log("failed to create scatter handle\n");
+	return lease;
+}
+
 void DMAHandler::closeDMA()
 {
+	std::lock_guard lock(DMA_BACKEND_MUTEX);
+	if (!DMA_BACKEND)
+		return;
+
+	DMA_BACKEND->close();
+	DMA_BACKEND = nullptr;
 	log("DMA closed!");
-	DMA_HANDLE = nullptr;
-	VMMDLL_Close(DMA_HANDLE);
 }
 
 #if COUNT_TOTAL_READSIZE
 
 DWORD64 DMAHandler::getTotalReadSize()
 {
-	return readSize;
+	return readSize.load();
 }
 
 void DMAHandler::resetReadSize()
 {
-	log("Bytes read since last reset: %llu B, %llu KB, %llu MB", readSize, readSize / 1024, readSize / 1024 / 1024);
-	readSize = 0;
+	const DWORD64 size = readSize.reset();
+	log("Bytes read since last reset: %llu B, %llu KB, %llu MB", size, size / 1024, size / 1024 / 1024);
 }
 
 #endif
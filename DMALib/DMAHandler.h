@@ -1,29 +1,56 @@
 #pragma once
 #include <string>
-#include <Windows.h>
-#include <vmmdll.h>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "DMACompat.h"
+#include "DMABackend.h"
+#include "CoalescingBackend.h"
+#include "PageCacheBackend.h"
+#include "PatternScanner.h"
+#include "ReadPolicy.h"
+#include "ScatterHandlePool.h"
+#include "ShardedCounter.h"
+#include "ThreadPool.h"
 
 // set to FALSE if you dont want to track the total read size of the DMA
 #define COUNT_TOTAL_READSIZE TRUE
 
+// set to FALSE to build without MemProcFS, only custom backends (e.g. FileBackend) are available then
+#ifndef DMALIB_WITH_VMM
+#define DMALIB_WITH_VMM TRUE
+#endif
+
+/**
+ * \brief Access to the memory of one process through a DMABackend.
+ *
+ * Thread safety: once constructed, reads, writes, scatters, ScatterBatch, BulkReader, RemoteView, prefetch
+ * and pattern scans may be called from any number of threads at once, as long as the backend allows it (see
+ * DMABackend, all backends of the library do). Every thread brings its own scatter handles and a handle is only
+ * used by one thread at a time. Leases from the pool are fine, see ScatterHandlePool for its per thread slots. The read size counter is kept per thread and merged on demand.
+ * Pattern scans share the module images of the object and run one at a time, each one uses all cores already.
+ * Setup calls (enableScatterCoalescing, enableReadCache, setReadPolicy, setScanSections, setModuleCacheTTL)
+ * change what the other calls use and are not synchronized with them, make them before the workers start.
+ */
 class DMAHandler
 {
 
 	// Static variables, shared over all instances
 
-	struct LibModules
-	{
-		HMODULE VMM = nullptr;
-		HMODULE FTD3XX = nullptr;
-		HMODULE LEECHCORE = nullptr;
-	};
-
-	static inline LibModules modules{};
+	// The VMM backend shared by every instance created without an explicit backend
+	static inline std::shared_ptr<DMABackend> DMA_BACKEND = nullptr;
 
-	static inline VMM_HANDLE DMA_HANDLE = nullptr;
+	// Guards DMA_BACKEND, handlers may be created on several threads at once
+	static inline std::mutex DMA_BACKEND_MUTEX;
 
 	// Counts the size of the reads in total. Reset every frame preferrably for memory tracking
-	static inline DWORD64 readSize = 0;
+	static inline ShardedCounter<> readSize;
 
 	// Nonstatic variables, different for each class object on purpose, in case the user tries to access
 	// multiple processes
@@ -32,35 +59,171 @@ class DMAHandler
 		DWORD pid = 0;
 		std::string name;
 		const wchar_t* wname;
-		ULONG64 base = 0;
+		// resolved on the first getBaseAddress, any thread may be the first
+		std::atomic<ULONG64> base = 0;
 	};
 
 	BaseProcessInfo processInfo{};
 
 	BOOLEAN PROCESS_INITIALIZED = FALSE;
 
+	// The backend every memory access of this instance is routed through
+	std::shared_ptr<DMABackend> backend = nullptr;
 
-	// Private log function used by the DMAHandler class
-	static void log(const char* fmt, ...);
+	// The page cache layer of backend, if enabled
+	std::shared_ptr<PageCacheBackend> pageCache = nullptr;
+
+	// Flags of reads and scatter handles that do not bring their own policy
+	ReadPolicy readPolicy{};
+
+	// Runs the async scatters, started by the first one. Declared after backend so it is joined before the backend goes away
+	mutable std::unique_ptr<ThreadPool> ioThread;
+	mutable std::once_flag ioThreadOnce;
+
+	ThreadPool& getIOThread() const;
+
+	// pages hinted since the last prefetch job started, the next job takes all of them at once
+	mutable std::vector<ULONG64> prefetchPending;
+	mutable bool prefetchScheduled = false;
+	mutable std::mutex prefetchMutex;
+
+	// Issues the prefetch hints, separate from the I/O thread so hints never delay an async scatter. Declared after the state its jobs use
+	mutable std::unique_ptr<ThreadPool> prefetchThread;
+	mutable std::once_flag prefetchThreadOnce;
+
+	// Takes the pending hints and hands them to the backend, runs on the prefetch thread
+	void runPrefetch() const;
+
+	// Scatter handles reused across batches, created on the first acquire. Replaced, not cleared, when the handles go stale, leases keep the old one alive
+	mutable std::shared_ptr<ScatterHandlePool> scatterPool;
+	mutable std::mutex scatterPoolMutex;
+
+	// Executes and clears a scatter read handle, false if the execute failed
+	bool runScatterRead(VMMDLL_SCATTER_HANDLE handle) const;
 
 	// Will always throw a runtime error if PROCESS_INITIALIZED or DMA_INITIALIZED is false
 	void assertNoInit() const;
 
+	// Looks up the PID of the process on the backend
+	void attachProcess(const wchar_t* wname);
+
 	// Wow we have friends
 	template<typename> friend class DMAScatter;
+	friend class ScatterBatch;
+
+	void retrieveScatter(VMMDLL_SCATTER_HANDLE handle, void* buffer, void* target, SIZE_T size) const;
+
+	// Parsed PE headers of a module, the images of all its sections share one arena
+	struct ModuleImage
+	{
+		struct Section
+		{
+			std::string name;
+			DWORD characteristics;
+			uint64_t address;
+			// position of the image inside the arena
+			size_t offset;
+			size_t size;
+			bool loaded = false;
+		};
+
+		uint64_t base = 0;
+		std::vector<Section> sections;
+		// a single allocation for every section, each one is read on the first scan that needs it
+		std::unique_ptr<uint8_t[]> arena;
+	};
+
+	// (pid, lower case module name) -> image, filled by loadModule
+	std::map<std::pair<DWORD, std::string>, std::unique_ptr<ModuleImage>> moduleImages;
+
+	// A pattern scan result is cached by the contents of the signature, not the pointer to the pattern
+	struct PatternKey
+	{
+		std::string module;
+		Signature signature;
+		bool returnCSOffset;
+
+		bool operator==(const PatternKey& other) const = default;
+	};
+
+	struct PatternKeyHash
+	{
+		size_t operator()(const PatternKey& key) const
+		{
+			return std::hash<std::string>()(key.module) ^ key.signature.hash() * 31 ^ key.returnCSOffset;
+		}
+	};
+
+	// Found addresses of single and batched pattern scans
+	std::unordered_map<PatternKey, ULONG64, PatternKeyHash> patternCache;
+
+	// Guards moduleImages, patternCache and scanSectionNames, held for a whole scan
+	std::mutex scanMutex;
 
-	static void retrieveScatter(VMMDLL_SCATTER_HANDLE handle, void* buffer, void* target, SIZE_T size);
+	// Names of the sections pattern scans look at, empty for all executable ones
+	std::vector<std::string> scanSectionNames;
+
+	// Parses the PE headers of the module on the first call, nullptr if the module is not loaded. Throws if the PE headers are invalid
+	ModuleImage* loadModule(const std::string& moduleName);
+
+	// The sections of the module selected for pattern scans, reads their images if needed
+	std::vector<ScanRegion> scanRegions(ModuleImage& module);
+
+	// Resolves the xxx, cs:offset instruction at offset to the address of the global variable
+	static ULONG64 resolveCSOffset(const ScanRegion& region, size_t offset);
 
-	static bool DumpMemoryMap();
-	
 public:
+	// Log function used by the DMALib classes
+	static void log(const char* fmt, ...);
+
 	/**
 	 * \brief Constructor takes a wide string of the process.
 	 * Expects that all the libraries are in the root dir
 	 * \param wname process name
-	 * \param memMap whether the memory map should get dumped to file.
+	 * \param memMap whether the physical memory map of the target should be applied, so reads skip unbacked ranges
+	 * \param cacheFile keeps the memory map, pids and module bases of the target in this file, a restart before the target reboots skips their lookups. nullptr for none
 	 */
-	DMAHandler(const wchar_t* wname, bool memMap = true);
+	DMAHandler(const wchar_t* wname, bool memMap = true, const char* cacheFile = nullptr);
+
+	/**
+	 * \brief Constructor for a custom backend, e.g. a FileBackend when there is no device attached.
+	 * \param wname process name
+	 * \param backend the backend all reads, writes and scatters of this object go through
+	 */
+	DMAHandler(const wchar_t* wname, std::shared_ptr<DMABackend> backend);
+
+	/**
+	 * \brief the shared VMM backend of the constructor above, connects the device on the first call.
+	 * Safe to call from several threads, the device is connected once.
+	 * \return the backend, check isInitialized on it. nullptr if DMALib was built without MemProcFS and none was set
+	 */
+	static std::shared_ptr<DMABackend> connect(bool memMap = true, const char* cacheFile = nullptr);
+
+	// The backend this object uses
+	DMABackend* getBackend() const;
+
+	/**
+	 * \brief merges the scatter reads of this object before they are issued, see CoalescingBackend.
+	 * Wraps the current backend, so call it before creating scatter handles and while no async scatter is running.
+	 * Replaces the scatter handle pool. A lease that is still out returns its handle to the old pool, it belongs to the old backend
+	 * and must not be used for scatters anymore.
+	 * \return the coalescing layer, e.g. for its merge counters
+	 */
+	std::shared_ptr<CoalescingBackend> enableScatterCoalescing(const CoalescingConfig& config = {});
+
+	/**
+	 * \brief caches the pages of plain reads of this object, see PageCacheBackend.
+	 * Call advanceGeneration on the returned cache once per frame. Same rules as enableScatterCoalescing.
+	 * \return the cache layer, e.g. for its TTL regions and hit counters
+	 */
+	std::shared_ptr<PageCacheBackend> enableReadCache(const PageCacheConfig& config = {});
+
+	/**
+	 * \brief sets the TTL of the image of a module in the page cache, e.g. PageCacheBackend::FOREVER for code that never changes
+	 * \param moduleName module, empty for the main module
+	 * \return false if the cache is not enabled or the module is not loaded
+	 */
+	bool setModuleCacheTTL(const std::string& moduleName, ULONG64 ttl);
 
 	// Whether the DMA and Process are initialized
 	bool isInitialized() const;
@@ -71,24 +234,60 @@ public:
 	// Gets the Base address of the process
 	ULONG64 getBaseAddress();
 
-	void read(ULONG64 address, ULONG64 buffer, SIZE_T size) const;
+	/**
+	 * \brief sets the policy of every read and scatter handle of this object that does not bring its own, see ReadPolicy.
+	 * Replaces the scatter handle pool if the scatter flags change. Leases that are still out keep reading with the old flags
+	 * and return their handles to the old pool.
+	 */
+	void setReadPolicy(const ReadPolicy& policy);
+
+	const ReadPolicy& getReadPolicy() const;
+
+	// Returns what the backend returned, false if none of the bytes could be read
+	bool read(ULONG64 address, ULONG64 buffer, SIZE_T size) const;
+
+	// Same as above with the flags of the given policy instead of the one of this object
+	bool read(ULONG64 address, ULONG64 buffer, SIZE_T size, const ReadPolicy& policy) const;
 
 	template <typename T>
 	T read(void* address)
+	{
+		return read<T>(address, readPolicy);
+	}
+
+	template <typename T>
+	T read(ULONG64 address)
+	{
+		return read<T>(reinterpret_cast<void*>(address));
+	}
+
+	template <typename T>
+	T read(void* address, const ReadPolicy& policy)
 	{
 		T buffer{};
 		memset(&buffer, 0, sizeof(T));
-		read(reinterpret_cast<ULONG64>(address), reinterpret_cast<ULONG64>(&buffer), sizeof(T));
+		read(reinterpret_cast<ULONG64>(address), reinterpret_cast<ULONG64>(&buffer), sizeof(T), policy);
 
 		return buffer;
 	}
 
 	template <typename T>
-	T read(ULONG64 address)
+	T read(ULONG64 address, const ReadPolicy& policy)
 	{
-		return read<T>(reinterpret_cast<void*>(address));
+		return read<T>(reinterpret_cast<void*>(address), policy);
 	}
 
+	/**
+	 * \brief hints that the pages of the addresses will be read soon, e.g. the next nodes of a list or the section headers before a scan.
+	 * Returns right away, the pages are fetched into the MemProcFS data cache on a background thread with VMMDLL_MemPrefetchPages.
+	 * Hints given while a prefetch is running are collected and sent as one batch. Only reads that may use the
+	 * data cache benefit, e.g. with ReadPolicy::cachedStatic.
+	 */
+	void prefetch(std::span<const ULONG64> addresses) const;
+
+	// Same as above for every page of a range
+	void prefetch(ULONG64 address, SIZE_T size) const;
+
 	bool write(ULONG64 address, ULONG64 buffer, SIZE_T size) const;
 
 	template <typename T>
@@ -117,7 +316,20 @@ public:
 
 	//Handle Scatter
 	void queueScatterReadEx(VMMDLL_SCATTER_HANDLE handle, uint64_t addr, void* bffr, size_t size) const;
-	void executeScatterRead(VMMDLL_SCATTER_HANDLE handle) const;
+	// false if the execute failed
+	bool executeScatterRead(VMMDLL_SCATTER_HANDLE handle) const;
+
+	/**
+	 * \brief executeScatterRead on the I/O thread of this object, returns right away so the next batch can be prepared meanwhile.
+	 * The handle and the buffers of its reads must not be touched until the read completed, use a second handle for the next batch.
+	 * \return future that is ready once the buffers are filled, holds false if the execute failed
+	 */
+	std::future<bool> executeScatterReadAsync(VMMDLL_SCATTER_HANDLE handle) const;
+
+	/**
+	 * \brief same as above, but onComplete is called on the I/O thread once the buffers are filled
+	 */
+	void executeScatterReadAsync(VMMDLL_SCATTER_HANDLE handle, std::function<void(bool)> onComplete) const;
 
 	void queueScatterWriteEx(VMMDLL_SCATTER_HANDLE handle, uint64_t addr, void* bffr, size_t size) const;
 	void executeScatterWrite(VMMDLL_SCATTER_HANDLE handle) const;
@@ -125,18 +337,58 @@ public:
 	VMMDLL_SCATTER_HANDLE createScatterHandle() const;
 	void closeScatterHandle(VMMDLL_SCATTER_HANDLE& handle) const;
 
+	/**
+	 * \brief borrows a scatter handle from the pool of this object instead of creating one.
+	 * The handle goes back to the pool, cleared, when the lease is destroyed. The lease keeps its pool and backend alive,
+	 * so it stays valid if the pool is replaced meanwhile (setReadPolicy, enableScatterCoalescing, enableReadCache) or this object is destroyed.
+	 * \return the lease, converts to VMMDLL_SCATTER_HANDLE
+	 */
+	ScatterHandlePool::Lease acquireScatterHandle() const;
+
+	// The scatter handle pool of this object, e.g. for its hit/miss counters
+	std::shared_ptr<ScatterHandlePool> getScatterPool() const;
+
+
+	/**
+	 * \brief limits pattern scans to the given sections, e.g. { ".text", ".themida" }. By default all executable sections are scanned.
+	 * Applies to every module and drops the cached pattern scan results.
+	 * \param names section names, an empty list restores the default
+	 */
+	void setScanSections(std::vector<std::string> names);
 
 	/**
-	 * \brief pattern scans the text section and returns 0 if unsuccessful
+	 * \brief pattern scans the executable sections of a module on the shared thread pool and returns 0 if unsuccessful.
+	 * If the pattern matches more than once, the lowest address wins.
 	 * \param pattern the pattern
 	 * \param mask the mask
 	 * \param returnCSOffset in case your pattern leads to a xxx, cs:offset, it will return the address of the global variable instead
+	 * \param moduleName module to scan, e.g. "client.dll". Empty scans the main module
 	 * \return the address
 	 */
-	ULONG64 patternScan(const char* pattern, const std::string& mask, bool returnCSOffset = true);
+	ULONG64 patternScan(const char* pattern, const std::string& mask, bool returnCSOffset = true, const std::string& moduleName = "");
+
+	/**
+	 * \brief resolves a batch of IDA style signatures ("48 8B 05 ? ? ? ? 48 85 C0") in a single sharded pass over the executable sections of a module
+	 * \param signatures the signatures
+	 * \param returnCSOffset same as for the single pattern scan, applied to every signature
+	 * \param moduleName module to scan, empty scans the main module
+	 * \return one address per signature, 0 for the ones that were not found
+	 */
+	std::vector<ULONG64> patternScan(const std::vector<std::string>& signatures, bool returnCSOffset = true, const std::string& moduleName = "");
+
+	/**
+	 * \brief lazily finds every match of a signature in the executable sections of a module, in address order.
+	 * Stop iterating at any time, the rest of the module is not scanned then. The range reads from the module images
+	 * cached by this object, so it must not outlive it.
+	 * \param signature e.g. Signature::fromIDA("48 8B 05 ? ? ? ?") or Signature::fromMask(pattern, mask)
+	 * \param moduleName module to scan, empty scans the main module
+	 * \return range of ScanMatch, address holds the address of the match
+	 */
+	MatchRange patternScanAll(const Signature& signature, const std::string& moduleName = "");
 
 	/**
-	 * \brief closes the DMA and sets DMA_INITIALIZED to FALSE. Do not call on every object, only at the end of your program.
+	 * \brief closes the shared VMM backend. Do not call on every object, only at the end of your program.
+	 * Objects created with a custom backend are not affected.
 	 */
 	static void closeDMA();
 
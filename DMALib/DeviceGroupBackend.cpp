@@ -0,0 +1,300 @@
+#include "DeviceGroupBackend.h"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+
+DeviceGroupBackend::DeviceGroupBackend(std::vector<std::shared_ptr<DMABackend>> devices, const DeviceGroupConfig& config)
+	: devices(std::move(devices)), config(config)
+{
+	if (!this->config.stripeSize)
+		this->config.stripeSize = 0x1000;
+
+	stats.resize(this->devices.size());
+	// the first device runs on the calling thread
+	if (this->devices.size() > 1)
+		workers = std::make_unique<ThreadPool>(this->devices.size() - 1);
+}
+
+DWORD DeviceGroupBackend::queueDepthOf(size_t device) const
+{
+	const DWORD depth = device < config.queueDepths.size() ? config.queueDepths[device] : config.defaultQueueDepth;
+	return std::max<DWORD>(depth, 1);
+}
+
+bool DeviceGroupBackend::forEachDevice(const std::function<bool(size_t)>& work)
+{
+	std::vector<std::future<bool>> pending;
+	pending.reserve(devices.size());
+	for (size_t device = 1; device < devices.size(); device++)
+		pending.push_back(workers->submit([&work, device] { return work(device); }));
+
+	bool success = work(0);
+	for (auto& result : pending)
+		success &= result.get();
+	return success;
+}
+
+void DeviceGroupBackend::account(size_t device, ULONG64 entries, ULONG64 rounds, ULONG64 bytes)
+{
+	std::lock_guard lock(mutex);
+	stats[device].entries += entries;
+	stats[device].rounds += rounds;
+	stats[device].bytes += bytes;
+}
+
+std::vector<DeviceGroupBackend::DeviceStats> DeviceGroupBackend::getStats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
+
+void DeviceGroupBackend::resetStats()
+{
+	std::lock_guard lock(mutex);
+	std::fill(stats.begin(), stats.end(), DeviceStats{});
+}
+
+bool DeviceGroupBackend::isInitialized() const
+{
+	if (devices.empty())
+		return false;
+
+	return std::all_of(devices.begin(), devices.end(), [](const auto& device) { return device->isInitialized(); });
+}
+
+void DeviceGroupBackend::close()
+{
+	for (const auto& device : devices)
+		device->close();
+}
+
+ULONG64 DeviceGroupBackend::getTargetFingerprint()
+{
+	return devices.empty() ? 0 : devices.front()->getTargetFingerprint();
+}
+
+bool DeviceGroupBackend::getPidFromName(const char* processName, DWORD* pid)
+{
+	return !devices.empty() && devices.front()->getPidFromName(processName, pid);
+}
+
+ULONG64 DeviceGroupBackend::getModuleBase(DWORD pid, const char* moduleName)
+{
+	return devices.empty() ? 0 : devices.front()->getModuleBase(pid, moduleName);
+}
+
+bool DeviceGroupBackend::read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags)
+{
+	if (devices.empty())
+		return false;
+
+	if (devices.size() == 1 || size <= config.stripeSize)
+	{
+		const size_t device = deviceOf(address);
+		const bool success = devices[device]->read(pid, address, buffer, size, bytesRead, flags);
+		account(device, 1, 1, size);
+		return success;
+	}
+
+	// one contiguous part per device, cut at stripe boundaries so no device reads a page twice
+	const ULONG64 first = address / config.stripeSize;
+	const ULONG64 stripes = (address + size - 1) / config.stripeSize - first + 1;
+	const ULONG64 perDevice = (stripes + devices.size() - 1) / devices.size();
+	std::vector<DWORD> partRead(devices.size(), 0);
+
+	const bool success = forEachDevice([&](size_t device)
+	{
+		const ULONG64 start = std::max(address, (first + device * perDevice) * config.stripeSize);
+		const ULONG64 end = std::min(address + size, (first + (device + 1) * perDevice) * config.stripeSize);
+		if (start >= end)
+			return true;
+
+		const DWORD length = static_cast<DWORD>(end - start);
+		const bool partSuccess = devices[device]->read(pid, start, buffer + (start - address), length, &partRead[device], flags);
+		account(device, 1, 1, length);
+		return partSuccess;
+	});
+
+	if (bytesRead)
+	{
+		*bytesRead = 0;
+		for (const DWORD part : partRead)
+			*bytesRead += part;
+	}
+	return success;
+}
+
+bool DeviceGroupBackend::write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	return !devices.empty() && devices[deviceOf(address)]->write(pid, address, buffer, size);
+}
+
+bool DeviceGroupBackend::prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count)
+{
+	if (devices.empty())
+		return false;
+
+	// routed like scatter reads, so the pages end up in the cache of the device the scatter asks
+	std::vector<std::vector<ULONG64>> shares(devices.size());
+	for (DWORD i = 0; i < count; i++)
+		shares[deviceOf(addresses[i])].push_back(addresses[i]);
+
+	bool success = true;
+	for (size_t device = 0; device < devices.size(); device++)
+	{
+		if (!shares[device].empty())
+			success &= devices[device]->prefetchPages(pid, shares[device].data(), static_cast<DWORD>(shares[device].size()));
+	}
+	return success;
+}
+
+VMMDLL_SCATTER_HANDLE DeviceGroupBackend::scatterInitialize(DWORD pid, DWORD flags)
+{
+	if (devices.empty())
+		return nullptr;
+
+	auto* group = new Group();
+	group->pid = pid;
+	group->flags = flags;
+	for (const auto& device : devices)
+	{
+		const VMMDLL_SCATTER_HANDLE handle = device->scatterInitialize(pid, flags);
+		if (!handle)
+		{
+			scatterClose(reinterpret_cast<VMMDLL_SCATTER_HANDLE>(group));
+			return nullptr;
+		}
+		group->handles.push_back(handle);
+	}
+	return reinterpret_cast<VMMDLL_SCATTER_HANDLE>(group);
+}
+
+bool DeviceGroupBackend::scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	if (!handle)
+		return false;
+
+	ReadEntry entry{ address, size, buffer, bytesRead, {}, 0 };
+	if (!buffer)
+		entry.internal.resize(size);
+
+	toGroup(handle)->reads.push_back(std::move(entry));
+	return true;
+}
+
+bool DeviceGroupBackend::scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	if (!handle)
+		return false;
+
+	toGroup(handle)->writes.push_back(WriteEntry{ address, std::vector<BYTE>(buffer, buffer + size) });
+	return true;
+}
+
+bool DeviceGroupBackend::executeShare(Group& group, size_t device, const std::vector<size_t>& share)
+{
+	DMABackend& backend = *devices[device];
+	const VMMDLL_SCATTER_HANDLE handle = group.handles[device];
+	const DWORD depth = queueDepthOf(device);
+
+	bool success = true;
+	ULONG64 rounds = 0, bytes = 0;
+	for (size_t begin = 0; begin < share.size(); begin += depth)
+	{
+		const size_t end = std::min(share.size(), begin + depth);
+		success &= backend.scatterClear(handle, group.pid, group.flags);
+		for (size_t i = begin; i < end; i++)
+		{
+			ReadEntry& entry = group.reads[share[i]];
+			success &= backend.scatterPrepare(handle, entry.address, entry.size, entry.buffer ? entry.buffer : entry.internal.data(), &entry.internalRead);
+			bytes += entry.size;
+		}
+		success &= backend.scatterExecuteRead(handle);
+		rounds++;
+	}
+
+	account(device, share.size(), rounds, bytes);
+	return success;
+}
+
+bool DeviceGroupBackend::scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle)
+{
+	if (!handle || devices.empty())
+		return false;
+
+	Group& group = *toGroup(handle);
+	std::vector<std::vector<size_t>> shares(devices.size());
+	for (size_t i = 0; i < group.reads.size(); i++)
+	{
+		group.reads[i].internalRead = 0;
+		shares[deviceOf(group.reads[i].address)].push_back(i);
+	}
+
+	const bool success = forEachDevice([&](size_t device)
+	{
+		return shares[device].empty() || executeShare(group, device, shares[device]);
+	});
+
+	for (const auto& entry : group.reads)
+	{
+		if (entry.bytesRead)
+			*entry.bytesRead = entry.internalRead;
+	}
+	return success;
+}
+
+bool DeviceGroupBackend::scatterExecute(VMMDLL_SCATTER_HANDLE handle)
+{
+	if (!handle || devices.empty())
+		return false;
+
+	Group& group = *toGroup(handle);
+	for (auto& entry : group.writes)
+		write(group.pid, entry.address, entry.data.data(), static_cast<DWORD>(entry.data.size()));
+
+	return scatterExecuteRead(handle);
+}
+
+bool DeviceGroupBackend::scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	if (!handle)
+		return false;
+
+	for (const auto& entry : toGroup(handle)->reads)
+	{
+		if (entry.buffer || address < entry.address || address + size > entry.address + entry.size)
+			continue;
+
+		memcpy(buffer, entry.internal.data() + (address - entry.address), size);
+		if (bytesRead)
+			*bytesRead = entry.internalRead ? size : 0;
+		return entry.internalRead != 0;
+	}
+	return false;
+}
+
+bool DeviceGroupBackend::scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags)
+{
+	if (!handle)
+		return false;
+
+	Group& group = *toGroup(handle);
+	group.reads.clear();
+	group.writes.clear();
+	if (pid)
+		group.pid = pid;
+	group.flags = flags;
+	return true;
+}
+
+void DeviceGroupBackend::scatterClose(VMMDLL_SCATTER_HANDLE handle)
+{
+	if (!handle)
+		return;
+
+	Group* group = toGroup(handle);
+	for (size_t device = 0; device < group->handles.size(); device++)
+		devices[device]->scatterClose(group->handles[device]);
+	delete group;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include "DMABackend.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * \brief Rules for spreading the reads of a DeviceGroupBackend over its devices
+ */
+struct DeviceGroupConfig
+{
+	// scatter reads are sharded by stripe, every read starting in a stripe goes to the same device. Stripe n goes to device n % count
+	ULONG64 stripeSize = 0x1000;
+	// most scatter entries a device is given in one round, larger shares are executed in several rounds. One per device, devices past the end use defaultQueueDepth
+	std::vector<DWORD> queueDepths;
+	DWORD defaultQueueDepth = 512;
+};
+
+/**
+ * \brief Backend that drives several acquisition devices attached to the same target as one.
+ * Every device is a backend of its own (e.g. one VMMBackend per FPGA), the group splits the work between them:
+ * the reads of a scatter are sharded by stripe and every device executes its share at the same time on its own
+ * worker, a plain read larger than a stripe is split into one contiguous part per device.
+ * Process lookups and everything that is not a read go to the first device.
+ *
+ *	auto group = std::make_shared<DeviceGroupBackend>(std::vector<std::shared_ptr<DMABackend>>{
+ *		std::make_shared<VMMBackend>(true, nullptr, "fpga://deviceindex=0"),
+ *		std::make_shared<VMMBackend>(true, nullptr, "fpga://deviceindex=1") });
+ *	DMAHandler target(L"game.exe", group);
+ */
+class DeviceGroupBackend : public DMABackend
+{
+public:
+	struct DeviceStats
+	{
+		// scatter entries and plain read parts executed by the device
+		ULONG64 entries = 0;
+		// scatter rounds and plain reads issued to the device
+		ULONG64 rounds = 0;
+		ULONG64 bytes = 0;
+	};
+
+private:
+	struct ReadEntry
+	{
+		ULONG64 address;
+		DWORD size;
+		PBYTE buffer;
+		DWORD* bytesRead;
+		// holds the data of a read prepared without a buffer, see scatterRead
+		std::vector<BYTE> internal;
+		DWORD internalRead = 0;
+	};
+
+	struct WriteEntry
+	{
+		ULONG64 address;
+		std::vector<BYTE> data;
+	};
+
+	// State behind a scatter handle of the group
+	struct Group
+	{
+		DWORD pid;
+		DWORD flags;
+		// one handle per device, created with the group
+		std::vector<VMMDLL_SCATTER_HANDLE> handles;
+		std::vector<ReadEntry> reads;
+		std::vector<WriteEntry> writes;
+	};
+
+	std::vector<std::shared_ptr<DMABackend>> devices;
+	DeviceGroupConfig config;
+	// runs the shares of every device but the first, that one runs on the calling thread
+	std::unique_ptr<ThreadPool> workers;
+	std::vector<DeviceStats> stats;
+	// guards stats
+	mutable std::mutex mutex;
+
+	static Group* toGroup(VMMDLL_SCATTER_HANDLE handle) { return reinterpret_cast<Group*>(handle); }
+
+	size_t deviceOf(ULONG64 address) const { return address / config.stripeSize % devices.size(); }
+
+	DWORD queueDepthOf(size_t device) const;
+
+	// Runs work for every device at the same time and waits for all of them, false if any failed
+	bool forEachDevice(const std::function<bool(size_t)>& work);
+
+	// Executes the reads of a device on its handle, in rounds of its queue depth
+	bool executeShare(Group& group, size_t device, const std::vector<size_t>& share);
+
+	void account(size_t device, ULONG64 entries, ULONG64 rounds, ULONG64 bytes);
+
+public:
+	/**
+	 * \param devices backends of the devices, all attached to the same target
+	 */
+	DeviceGroupBackend(std::vector<std::shared_ptr<DMABackend>> devices, const DeviceGroupConfig& config = {});
+
+	const DeviceGroupConfig& getConfig() const { return config; }
+
+	size_t deviceCount() const { return devices.size(); }
+
+	std::vector<DeviceStats> getStats() const;
+
+	void resetStats();
+
+	const char* name() const override { return "devicegroup"; }
+
+	// Whether every device is initialized
+	bool isInitialized() const override;
+
+	void close() override;
+
+	ULONG64 getTargetFingerprint() override;
+
+	bool getPidFromName(const char* processName, DWORD* pid) override;
+	ULONG64 getModuleBase(DWORD pid, const char* moduleName) override;
+
+	bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) override;
+	bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) override;
+
+	VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) override;
+	bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) override;
+	void scatterClose(VMMDLL_SCATTER_HANDLE handle) override;
+};
@@ -0,0 +1,411 @@
+#include "FileBackend.h"
+#include "DMAHandler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Emulated scatter handle, handed out as VMMDLL_SCATTER_HANDLE
+	struct ScatterState
+	{
+		struct ReadEntry
+		{
+			ULONG64 address;
+			DWORD size;
+			PBYTE buffer;
+			DWORD* bytesRead;
+			// used when no buffer was given, retrieved via scatterRead
+			std::vector<BYTE> internal;
+			DWORD internalRead;
+		};
+
+		struct WriteEntry
+		{
+			ULONG64 address;
+			std::vector<BYTE> data;
+		};
+
+		DWORD pid;
+		std::vector<ReadEntry> reads;
+		std::vector<WriteEntry> writes;
+	};
+
+	ScatterState* toState(VMMDLL_SCATTER_HANDLE handle)
+	{
+		return reinterpret_cast<ScatterState*>(handle);
+	}
+
+	bool equalsIgnoreCase(const std::string& a, const char* b)
+	{
+		const size_t length = strlen(b);
+		if (a.length() != length)
+			return false;
+
+		for (size_t i = 0; i < length; i++)
+		{
+			if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+				return false;
+		}
+		return true;
+	}
+}
+
+FileBackend::FileBackend(const char* processName, DWORD pid)
+	: processName(processName), pid(pid)
+{
+}
+
+FileBackend::~FileBackend()
+{
+	close();
+}
+
+bool FileBackend::addRegion(ULONG64 address, ULONG64 size, PBYTE data)
+{
+	if (!size)
+		return false;
+
+	const auto it = std::lower_bound(regions.begin(), regions.end(), address,
+		[](const Region& region, ULONG64 addr) { return region.address < addr; });
+
+	if (it != regions.end() && it->address < address + size)
+		return false;
+
+	if (it != regions.begin() && std::prev(it)->address + std::prev(it)->size > address)
+		return false;
+
+	regions.insert(it, Region{ address, size, data });
+	return true;
+}
+
+bool FileBackend::addImage(ULONG64 address, const void* data, ULONG64 size)
+{
+	auto image = std::make_unique<BYTE[]>(size);
+	if (data)
+		memcpy(image.get(), data, size);
+
+	if (!addRegion(address, size, image.get()))
+	{
+		DMAHandler::log("ERROR: image at 0x%llX overlaps an existing image!", address);
+		return false;
+	}
+	images.push_back(std::move(image));
+	return true;
+}
+
+bool FileBackend::mapFile(ULONG64 address, const char* path)
+{
+	MappedFile file{};
+
+#ifdef _WIN32
+	const HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		DMAHandler::log("ERROR: could not open %s", path);
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+	GetFileSizeEx(hFile, &fileSize);
+	file.size = fileSize.QuadPart;
+
+	const HANDLE hMapping = file.size ? CreateFileMappingA(hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+	CloseHandle(hFile);
+	if (!hMapping)
+	{
+		DMAHandler::log("ERROR: could not map %s", path);
+		return false;
+	}
+
+	file.view = MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(hMapping);
+#else
+	const int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		DMAHandler::log("ERROR: could not open %s", path);
+		return false;
+	}
+
+	struct stat st {};
+	fstat(fd, &st);
+	file.size = st.st_size;
+
+	if (file.size)
+	{
+		file.view = mmap(nullptr, file.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (file.view == MAP_FAILED)
+			file.view = nullptr;
+	}
+	::close(fd);
+#endif
+
+	if (!file.view)
+	{
+		DMAHandler::log("ERROR: could not map %s", path);
+		return false;
+	}
+
+	files.push_back(file);
+
+	if (!addRegion(address, file.size, static_cast<PBYTE>(file.view)))
+	{
+		DMAHandler::log("ERROR: %s at 0x%llX overlaps an existing image!", path, address);
+		return false;
+	}
+	return true;
+}
+
+void FileBackend::addModule(const char* moduleName, ULONG64 base)
+{
+	modules.push_back(Module{ moduleName, base });
+}
+
+DWORD FileBackend::copyFrom(ULONG64 address, PBYTE buffer, DWORD size) const
+{
+	memset(buffer, 0, size);
+
+	std::shared_lock lock(mutex);
+	DWORD copied = 0;
+	const ULONG64 end = address + size;
+
+	// first region that ends after address
+	auto it = std::upper_bound(regions.begin(), regions.end(), address,
+		[](ULONG64 addr, const Region& region) { return addr < region.address; });
+	if (it != regions.begin())
+		--it;
+
+	for (; it != regions.end() && it->address < end; ++it)
+	{
+		const ULONG64 from = std::max(address, it->address);
+		const ULONG64 to = std::min(end, it->address + it->size);
+		if (from >= to)
+			continue;
+
+		memcpy(buffer + (from - address), it->data + (from - it->address), to - from);
+		copied += static_cast<DWORD>(to - from);
+	}
+	return copied;
+}
+
+DWORD FileBackend::copyTo(ULONG64 address, const BYTE* buffer, DWORD size)
+{
+	std::lock_guard lock(mutex);
+	DWORD copied = 0;
+	const ULONG64 end = address + size;
+
+	auto it = std::upper_bound(regions.begin(), regions.end(), address,
+		[](ULONG64 addr, const Region& region) { return addr < region.address; });
+	if (it != regions.begin())
+		--it;
+
+	for (; it != regions.end() && it->address < end; ++it)
+	{
+		const ULONG64 from = std::max(address, it->address);
+		const ULONG64 to = std::min(end, it->address + it->size);
+		if (from >= to)
+			continue;
+
+		memcpy(it->data + (from - it->address), buffer + (from - address), to - from);
+		copied += static_cast<DWORD>(to - from);
+	}
+	return copied;
+}
+
+bool FileBackend::isInitialized() const
+{
+	return open;
+}
+
+void FileBackend::close()
+{
+	open = false;
+
+	for (const auto& file : files)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(file.view);
+#else
+		munmap(file.view, file.size);
+#endif
+	}
+	files.clear();
+	regions.clear();
+	images.clear();
+}
+
+ULONG64 FileBackend::getTargetFingerprint()
+{
+	// the layout of the address space, an image or module added in between is a different target
+	ULONG64 fingerprint = 0xCBF29CE484222325ull;
+	const auto mix = [&fingerprint](ULONG64 value) { fingerprint = (fingerprint ^ value) * 0x100000001B3ull; };
+
+	for (const char c : processName)
+		mix(static_cast<unsigned char>(c));
+	mix(pid);
+	for (const auto& region : regions)
+	{
+		mix(region.address);
+		mix(region.size);
+	}
+	for (const auto& module : modules)
+		mix(module.base);
+	return fingerprint;
+}
+
+bool FileBackend::getPidFromName(const char* processName, DWORD* pid)
+{
+	if (!open || !equalsIgnoreCase(this->processName, processName))
+		return false;
+
+	*pid = this->pid;
+	return true;
+}
+
+ULONG64 FileBackend::getModuleBase(DWORD pid, const char* moduleName)
+{
+	if (!open || pid != this->pid)
+		return 0;
+
+	for (const auto& module : modules)
+	{
+		if (equalsIgnoreCase(module.name, moduleName))
+			return module.base;
+	}
+	return 0;
+}
+
+bool FileBackend::read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 /*flags*/)
+{
+	DWORD copied = 0;
+	if (open && pid == this->pid)
+		copied = copyFrom(address, buffer, size);
+	else
+		memset(buffer, 0, size);
+
+	if (bytesRead)
+		*bytesRead = copied;
+
+	return copied != 0 || size == 0;
+}
+
+bool FileBackend::write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	if (!open || pid != this->pid)
+		return false;
+
+	return copyTo(address, buffer, size) == size;
+}
+
+bool FileBackend::prefetchPages(DWORD /*pid*/, const ULONG64* /*addresses*/, DWORD /*count*/)
+{
+	// the images are in memory already
+	return open;
+}
+
+VMMDLL_SCATTER_HANDLE FileBackend::scatterInitialize(DWORD pid, DWORD /*flags*/)
+{
+	if (!open)
+		return nullptr;
+
+	auto* state = new ScatterState();
+	state->pid = pid;
+	return reinterpret_cast<VMMDLL_SCATTER_HANDLE>(state);
+}
+
+bool FileBackend::scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	if (!handle)
+		return false;
+
+	ScatterState::ReadEntry entry{ address, size, buffer, bytesRead, {}, 0 };
+	if (!buffer)
+		entry.internal.resize(size);
+
+	toState(handle)->reads.push_back(std::move(entry));
+	return true;
+}
+
+bool FileBackend::scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	if (!handle)
+		return false;
+
+	toState(handle)->writes.push_back(ScatterState::WriteEntry{ address, std::vector<BYTE>(buffer, buffer + size) });
+	return true;
+}
+
+bool FileBackend::scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle)
+{
+	if (!handle || !open)
+		return false;
+
+	ScatterState* state = toState(handle);
+	for (auto& entry : state->reads)
+	{
+		PBYTE target = entry.buffer ? entry.buffer : entry.internal.data();
+		DWORD copied = 0;
+		read(state->pid, entry.address, target, entry.size, &copied, 0);
+
+		entry.internalRead = copied;
+		if (entry.bytesRead)
+			*entry.bytesRead = copied;
+	}
+	return true;
+}
+
+bool FileBackend::scatterExecute(VMMDLL_SCATTER_HANDLE handle)
+{
+	if (!handle || !open)
+		return false;
+
+	ScatterState* state = toState(handle);
+	for (auto& entry : state->writes)
+		write(state->pid, entry.address, entry.data.data(), static_cast<DWORD>(entry.data.size()));
+
+	return scatterExecuteRead(handle);
+}
+
+bool FileBackend::scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	if (!handle)
+		return false;
+
+	for (const auto& entry : toState(handle)->reads)
+	{
+		if (entry.buffer || address < entry.address || address + size > entry.address + entry.size)
+			continue;
+
+		memcpy(buffer, entry.internal.data() + (address - entry.address), size);
+		if (bytesRead)
+			*bytesRead = entry.internalRead ? size : 0;
+		return entry.internalRead != 0;
+	}
+	return false;
+}
+
+bool FileBackend::scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD /*flags*/)
+{
+	if (!handle)
+		return false;
+
+	ScatterState* state = toState(handle);
+	state->reads.clear();
+	state->writes.clear();
+	if (pid)
+		state->pid = pid;
+	return true;
+}
+
+void FileBackend::scatterClose(VMMDLL_SCATTER_HANDLE handle)
+{
+	delete toState(handle);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "DMABackend.h"
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+/**
+ * \brief In-process stand-in for the DMA device. Serves a single fake process whose
+ * address space is made of raw memory images and memory mapped files.
+ * Lets you run and benchmark the whole library without any hardware attached.
+ *
+ * Reads of unmapped memory are zero padded and only the mapped bytes are reported as read,
+ * writes go to a private copy and never reach the file on disk.
+ * Reads and writes may come from any number of threads, the images and files are added before the backend is shared.
+ */
+class FileBackend : public DMABackend
+{
+	struct Region
+	{
+		ULONG64 address = 0;
+		ULONG64 size = 0;
+		PBYTE data = nullptr;
+	};
+
+	struct MappedFile
+	{
+		void* view = nullptr;
+		ULONG64 size = 0;
+	};
+
+	struct Module
+	{
+		std::string name;
+		ULONG64 base = 0;
+	};
+
+	// sorted by address, never overlapping
+	std::vector<Region> regions;
+	std::vector<std::unique_ptr<BYTE[]>> images;
+	std::vector<MappedFile> files;
+	std::vector<Module> modules;
+
+	std::string processName;
+	DWORD pid;
+	bool open = true;
+	// reads share it, writes hold it alone so no read sees half of a write
+	mutable std::shared_mutex mutex;
+
+	bool addRegion(ULONG64 address, ULONG64 size, PBYTE data);
+
+	// Copies size bytes at address into buffer, zero pads the gaps and returns the amount of mapped bytes
+	DWORD copyFrom(ULONG64 address, PBYTE buffer, DWORD size) const;
+	DWORD copyTo(ULONG64 address, const BYTE* buffer, DWORD size);
+
+public:
+	/**
+	 * \brief creates an empty address space for a fake process
+	 * \param processName name returned by getPidFromName
+	 * \param pid the pid of the fake process
+	 */
+	explicit FileBackend(const char* processName = "stand-in.exe", DWORD pid = 4);
+
+	~FileBackend() override;
+
+	FileBackend(const FileBackend&) = delete;
+	FileBackend& operator=(const FileBackend&) = delete;
+
+	/**
+	 * \brief copies a raw memory image into the address space
+	 * \param address virtual address of the first byte
+	 * \param data image contents, nullptr for a zeroed image
+	 * \param size size of the image
+	 * \return false if the image overlaps an existing one
+	 */
+	bool addImage(ULONG64 address, const void* data, ULONG64 size);
+
+	/**
+	 * \brief maps a file into the address space (copy on write)
+	 * \param address virtual address of the first byte of the file
+	 * \param path path to the file
+	 * \return false if the file could not be mapped or overlaps an existing image
+	 */
+	bool mapFile(ULONG64 address, const char* path);
+
+	// Registers a module so getModuleBase can resolve it
+	void addModule(const char* moduleName, ULONG64 base);
+
+	const char* name() const override { return "file"; }
+
+	bool isInitialized() const override;
+
+	void close() override;
+
+	ULONG64 getTargetFingerprint() override;
+
+	bool getPidFromName(const char* processName, DWORD* pid) override;
+	ULONG64 getModuleBase(DWORD pid, const char* moduleName) override;
+
+	bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) override;
+	bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) override;
+
+	VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) override;
+	bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) override;
+	void scatterClose(VMMDLL_SCATTER_HANDLE handle) override;
+};
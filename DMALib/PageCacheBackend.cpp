@@ -0,0 +1,357 @@
+#include "PageCacheBackend.h"
+
+#include <algorithm>
+#include <cstring>
+
+PageCacheBackend::PageCacheBackend(std::shared_ptr<DMABackend> inner, const PageCacheConfig& config)
+	: inner(std::move(inner)), config(config)
+{
+	if (!this->config.pageSize)
+		this->config.pageSize = 0x1000;
+	if (!this->config.maxPages)
+		this->config.maxPages = 1;
+}
+
+void PageCacheBackend::setRegionTTL(DWORD pid, ULONG64 address, ULONG64 size, ULONG64 ttl)
+{
+	std::lock_guard lock(mutex);
+	regions.push_back(Region{ pid, address, address + size, ttl });
+	// pages already cached would keep the old TTL
+	drop(pid, address, size);
+}
+
+void PageCacheBackend::advanceGeneration()
+{
+	std::lock_guard lock(mutex);
+	generation++;
+}
+
+ULONG64 PageCacheBackend::getGeneration() const
+{
+	std::lock_guard lock(mutex);
+	return generation;
+}
+
+void PageCacheBackend::invalidate()
+{
+	std::lock_guard lock(mutex);
+	stats.evictions += pages.size();
+	pages.clear();
+	recent.clear();
+}
+
+void PageCacheBackend::invalidate(DWORD pid, ULONG64 address, ULONG64 size)
+{
+	std::lock_guard lock(mutex);
+	drop(pid, address, size);
+}
+
+PageCacheBackend::Stats PageCacheBackend::getStats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
+
+void PageCacheBackend::resetStats()
+{
+	std::lock_guard lock(mutex);
+	stats = {};
+}
+
+ULONG64 PageCacheBackend::ttlOf(DWORD pid, ULONG64 page) const
+{
+	for (auto it = regions.rbegin(); it != regions.rend(); ++it)
+	{
+		if (it->pid == pid && page + config.pageSize > it->start && page < it->end)
+			return it->ttl;
+	}
+	return config.defaultTTL;
+}
+
+bool PageCacheBackend::lookup(DWORD pid, ULONG64 page, ULONG64 from, DWORD size, PBYTE buffer)
+{
+	const auto it = pages.find(Key{ pid, page });
+	if (it == pages.end() || it->second.expires <= generation)
+		return false;
+
+	recent.splice(recent.begin(), recent, it->second.use);
+	memcpy(buffer, it->second.data.get() + (from - page), size);
+	return true;
+}
+
+void PageCacheBackend::store(DWORD pid, ULONG64 first, const BYTE* data, ULONG64 count)
+{
+	for (ULONG64 i = 0; i < count; i++)
+	{
+		const ULONG64 page = first + i * config.pageSize;
+		const ULONG64 ttl = ttlOf(pid, page);
+		if (!ttl)
+			continue;
+
+		auto it = pages.find(Key{ pid, page });
+		if (it == pages.end())
+		{
+			if (pages.size() >= config.maxPages)
+				evict();
+			recent.push_front(Key{ pid, page });
+			it = pages.emplace(Key{ pid, page }, Page{ 0, std::make_unique<BYTE[]>(config.pageSize), recent.begin() }).first;
+		}
+		else
+			recent.splice(recent.begin(), recent, it->second.use);
+
+		it->second.expires = ttl == FOREVER || generation > FOREVER - ttl ? FOREVER : generation + ttl;
+		memcpy(it->second.data.get(), data + i * config.pageSize, config.pageSize);
+	}
+}
+
+void PageCacheBackend::evict()
+{
+	// a batch at a time, so the scan for expired pages runs once per maxPages / 16 stores
+	const size_t target = config.maxPages - std::max<size_t>(config.maxPages / 16, 1);
+	for (auto it = pages.begin(); it != pages.end();)
+	{
+		const auto next = std::next(it);
+		if (it->second.expires <= generation)
+			erase(it);
+		it = next;
+	}
+
+	while (pages.size() > target)
+		erase(pages.find(recent.back()));
+}
+
+void PageCacheBackend::erase(std::unordered_map<Key, Page, KeyHash>::iterator page)
+{
+	recent.erase(page->second.use);
+	pages.erase(page);
+	stats.evictions++;
+}
+
+void PageCacheBackend::drop(DWORD pid, ULONG64 address, ULONG64 size)
+{
+	if (!size)
+		return;
+
+	const ULONG64 first = address - address % config.pageSize;
+	for (ULONG64 page = first; page < address + size; page += config.pageSize)
+	{
+		if (const auto it = pages.find(Key{ pid, page }); it != pages.end())
+			erase(it);
+	}
+}
+
+bool PageCacheBackend::isInitialized() const
+{
+	return inner && inner->isInitialized();
+}
+
+void PageCacheBackend::close()
+{
+	invalidate();
+	if (inner)
+		inner->close();
+}
+
+ULONG64 PageCacheBackend::getTargetFingerprint()
+{
+	return inner->getTargetFingerprint();
+}
+
+bool PageCacheBackend::getPidFromName(const char* processName, DWORD* pid)
+{
+	return inner->getPidFromName(processName, pid);
+}
+
+ULONG64 PageCacheBackend::getModuleBase(DWORD pid, const char* moduleName)
+{
+	return inner->getModuleBase(pid, moduleName);
+}
+
+bool PageCacheBackend::read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags)
+{
+	if (!size || size > config.maxReadSize || flags & DMALIB_FLAG_NOPAGECACHE)
+		return inner->read(pid, address, buffer, size, bytesRead, flags);
+
+	const ULONG64 pageSize = config.pageSize;
+	const ULONG64 first = address - address % pageSize;
+	const ULONG64 end = address + size;
+
+	// copy what is cached, remember the range of pages that is not
+	ULONG64 firstMissing = 0;
+	ULONG64 lastMissing = 0;
+	ULONG64 hits = 0;
+	ULONG64 misses = 0;
+	ULONG64 saved = 0;
+	bool cacheable = false;
+	{
+		std::lock_guard lock(mutex);
+		for (ULONG64 page = first; page < end; page += pageSize)
+		{
+			const ULONG64 from = std::max(address, page);
+			const DWORD length = static_cast<DWORD>(std::min(end, page + pageSize) - from);
+
+			cacheable |= ttlOf(pid, page) != 0;
+			if (lookup(pid, page, from, length, buffer + (from - address)))
+			{
+				hits++;
+				saved += length;
+				continue;
+			}
+
+			if (!misses)
+				firstMissing = page;
+			lastMissing = page;
+			misses++;
+		}
+
+		if (!cacheable)
+			hits = saved = 0;
+		stats.hits += hits;
+		stats.bytesSaved += saved;
+		stats.misses += cacheable ? misses : 0;
+	}
+
+	if (!misses)
+	{
+		if (bytesRead)
+			*bytesRead = size;
+		return true;
+	}
+
+	// volatile memory, read exactly what was asked for
+	if (!cacheable)
+		return inner->read(pid, address, buffer, size, bytesRead, flags);
+
+	ULONG64 epoch;
+	{
+		std::lock_guard lock(mutex);
+		epoch = writeEpoch;
+	}
+
+	const ULONG64 count = (lastMissing - firstMissing) / pageSize + 1;
+	std::vector<BYTE> data(count * pageSize);
+	DWORD read = 0;
+	inner->read(pid, firstMissing, data.data(), static_cast<DWORD>(data.size()), &read, flags);
+
+	// a page that failed can not be told apart from a zero page, only complete reads are kept
+	if (read != data.size())
+		return inner->read(pid, address, buffer, size, bytesRead, flags);
+
+	{
+		// a write that overlapped the read may have changed the pages after they were read
+		std::lock_guard lock(mutex);
+		if (epoch == writeEpoch)
+			store(pid, firstMissing, data.data(), count);
+	}
+
+	const ULONG64 from = std::max(address, firstMissing);
+	const ULONG64 to = std::min(end, lastMissing + pageSize);
+	memcpy(buffer + (from - address), data.data() + (from - firstMissing), to - from);
+
+	if (bytesRead)
+		*bytesRead = size;
+	return true;
+}
+
+bool PageCacheBackend::write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	{
+		std::lock_guard lock(mutex);
+		writeEpoch++;
+		drop(pid, address, size);
+	}
+	const bool success = inner->write(pid, address, buffer, size);
+	{
+		// a read that started before the write may have stored the old bytes meanwhile
+		std::lock_guard lock(mutex);
+		writeEpoch++;
+		drop(pid, address, size);
+	}
+	return success;
+}
+
+bool PageCacheBackend::prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count)
+{
+	return inner->prefetchPages(pid, addresses, count);
+}
+
+VMMDLL_SCATTER_HANDLE PageCacheBackend::scatterInitialize(DWORD pid, DWORD flags)
+{
+	const VMMDLL_SCATTER_HANDLE handle = inner->scatterInitialize(pid, flags);
+	if (handle)
+	{
+		std::lock_guard lock(mutex);
+		scatters[handle] = ScatterWrites{ pid, {} };
+	}
+	return handle;
+}
+
+bool PageCacheBackend::scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	return inner->scatterPrepare(handle, address, size, buffer, bytesRead);
+}
+
+bool PageCacheBackend::scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	{
+		// the device still holds the old bytes until the scatter is executed, the pages are dropped then
+		std::lock_guard lock(mutex);
+		if (const auto it = scatters.find(handle); it != scatters.end())
+			it->second.ranges.emplace_back(address, size);
+	}
+	return inner->scatterPrepareWrite(handle, address, buffer, size);
+}
+
+bool PageCacheBackend::scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle)
+{
+	return inner->scatterExecuteRead(handle);
+}
+
+bool PageCacheBackend::scatterExecute(VMMDLL_SCATTER_HANDLE handle)
+{
+	// same as write, drop before and after the writes reach the device
+	const auto dropWrites = [this, handle]
+	{
+		std::lock_guard lock(mutex);
+		const auto it = scatters.find(handle);
+		if (it == scatters.end() || it->second.ranges.empty())
+			return;
+
+		writeEpoch++;
+		for (const auto& [address, size] : it->second.ranges)
+			drop(it->second.pid, address, size);
+	};
+
+	dropWrites();
+	const bool success = inner->scatterExecute(handle);
+	dropWrites();
+	return success;
+}
+
+bool PageCacheBackend::scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	return inner->scatterRead(handle, address, size, buffer, bytesRead);
+}
+
+bool PageCacheBackend::scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags)
+{
+	{
+		std::lock_guard lock(mutex);
+		if (const auto it = scatters.find(handle); it != scatters.end())
+		{
+			it->second.ranges.clear();
+			if (pid)
+				it->second.pid = pid;
+		}
+	}
+	return inner->scatterClear(handle, pid, flags);
+}
+
+void PageCacheBackend::scatterClose(VMMDLL_SCATTER_HANDLE handle)
+{
+	{
+		std::lock_guard lock(mutex);
+		scatters.erase(handle);
+	}
+	inner->scatterClose(handle);
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include "DMABackend.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Rules for caching the pages of plain reads
+ */
+struct PageCacheConfig
+{
+	ULONG64 pageSize = 0x1000;
+	// most pages kept, once it is reached expired pages are dropped first, then the least recently used ones
+	size_t maxPages = 16384;
+	// generations a page outside of every region stays valid, 1 means until the next advanceGeneration
+	ULONG64 defaultTTL = 1;
+	// reads larger than this bypass the cache, so a module dump does not evict every other page
+	DWORD maxReadSize = 0x10000;
+};
+
+/**
+ * \brief Backend that wraps another backend and keeps the pages of plain reads, so reading the same page
+ * twice within a tick costs one round trip. Keyed by (pid, page address).
+ *
+ * Time is counted in generations, advanceGeneration is called once per tick (e.g. per frame).
+ * A page is valid for TTL generations after it was read, the TTL depends on the region it is in:
+ * a long one for module images, 0 (never cached) for heap memory that changes all the time.
+ * Writes through this backend drop the pages they touch, scatter reads and reads with DMALIB_FLAG_NOPAGECACHE pass through untouched.
+ */
+class PageCacheBackend : public DMABackend
+{
+public:
+	// TTL of pages that never expire, e.g. the code of a module
+	static constexpr ULONG64 FOREVER = ~0ull;
+
+	struct Stats
+	{
+		// pages served from the cache
+		ULONG64 hits = 0;
+		// pages read from the wrapped backend
+		ULONG64 misses = 0;
+		// bytes of reads served without a round trip
+		ULONG64 bytesSaved = 0;
+		ULONG64 evictions = 0;
+
+		double hitRate() const { return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+	};
+
+private:
+	struct Key
+	{
+		DWORD pid;
+		ULONG64 page;
+
+		bool operator==(const Key& other) const = default;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			return std::hash<ULONG64>()(key.page) ^ static_cast<size_t>(key.pid) * 0x9E3779B97F4A7C15ull;
+		}
+	};
+
+	struct Page
+	{
+		// generation the page stops being valid in
+		ULONG64 expires;
+		std::unique_ptr<BYTE[]> data;
+		// position in recent
+		std::list<Key>::iterator use;
+	};
+
+	struct Region
+	{
+		DWORD pid;
+		ULONG64 start;
+		ULONG64 end;
+		ULONG64 ttl;
+	};
+
+	struct ScatterWrites
+	{
+		DWORD pid;
+		// address and size of every queued write
+		std::vector<std::pair<ULONG64, DWORD>> ranges;
+	};
+
+	std::shared_ptr<DMABackend> inner;
+	PageCacheConfig config;
+	std::unordered_map<Key, Page, KeyHash> pages;
+	// keys of pages, most recently read or stored first
+	std::list<Key> recent;
+	// later regions win over earlier ones
+	std::vector<Region> regions;
+	ULONG64 generation = 0;
+	// bumped before and after every write reaches the device, a read only stores its pages if no write ran meanwhile
+	ULONG64 writeEpoch = 0;
+	// process and queued writes of every scatter handle, the pages they touch are dropped once the scatter is executed
+	std::unordered_map<VMMDLL_SCATTER_HANDLE, ScatterWrites> scatters;
+	Stats stats{};
+	// guards pages, recent, regions, generation, writeEpoch, scatters and stats, never held during a call to the wrapped backend
+	mutable std::mutex mutex;
+
+	// Expects mutex to be held
+	ULONG64 ttlOf(DWORD pid, ULONG64 page) const;
+
+	// Copies the cached part of a page into buffer, false if the page is not cached. Expects mutex to be held
+	bool lookup(DWORD pid, ULONG64 page, ULONG64 from, DWORD size, PBYTE buffer);
+
+	// Stores the pages of a page aligned read. Expects mutex to be held
+	void store(DWORD pid, ULONG64 first, const BYTE* data, ULONG64 count);
+
+	// Makes room for a page, drops the expired pages and then the least recently used ones until a sixteenth of maxPages is free.
+	// Expects mutex to be held
+	void evict();
+
+	// Drops a page. Expects mutex to be held
+	void erase(std::unordered_map<Key, Page, KeyHash>::iterator page);
+
+	// Drops the pages touched by a range. Expects mutex to be held
+	void drop(DWORD pid, ULONG64 address, ULONG64 size);
+
+public:
+	PageCacheBackend(std::shared_ptr<DMABackend> inner, const PageCacheConfig& config = {});
+
+	const PageCacheConfig& getConfig() const { return config; }
+
+	/**
+	 * \brief sets how many generations the pages of a range stay valid
+	 * \param ttl 0 never caches the range, FOREVER keeps its pages until they are invalidated
+	 */
+	void setRegionTTL(DWORD pid, ULONG64 address, ULONG64 size, ULONG64 ttl);
+
+	// Starts the next tick, pages read before expire according to their TTL
+	void advanceGeneration();
+
+	ULONG64 getGeneration() const;
+
+	// Drops every page
+	void invalidate();
+
+	// Drops the pages touched by the range
+	void invalidate(DWORD pid, ULONG64 address, ULONG64 size);
+
+	Stats getStats() const;
+
+	void resetStats();
+
+	const char* name() const override { return "pagecache"; }
+
+	bool isInitialized() const override;
+
+	void close() override;
+
+	ULONG64 getTargetFingerprint() override;
+
+	bool getPidFromName(const char* processName, DWORD* pid) override;
+	ULONG64 getModuleBase(DWORD pid, const char* moduleName) override;
+
+	bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) override;
+	bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) override;
+
+	VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) override;
+	bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) override;
+	void scatterClose(VMMDLL_SCATTER_HANDLE handle) override;
+};
@@ -0,0 +1,439 @@
+// Single signature scan kernels of PatternScanner::findFirst and the anchor kernels of PatternScanner::scanFirst, one per ScanLevel.
+// Every kernel is compiled for its instruction set on its own and only called after the CPUID check,
+// so the library itself does not need to be built with /arch:AVX2 or -mavx2.
+#include "PatternScanner.h"
+
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PATTERN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if PATTERN_X86 && (defined(__GNUC__) || defined(__clang__))
+#define PATTERN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PATTERN_TARGET(isa)
+#endif
+
+namespace
+{
+	// Positions of the first and the last fixed byte, candidates have to match both before they get verified
+	struct Anchors
+	{
+		size_t first;
+		size_t last;
+	};
+
+	bool verifyScalar(const uint8_t* data, const Signature& signature, size_t from)
+	{
+		for (size_t i = from; i < signature.size(); i++)
+		{
+			if ((data[i] ^ signature.bytes[i]) & signature.mask[i])
+				return false;
+		}
+		return true;
+	}
+
+	size_t findScalar(const uint8_t* data, size_t size, const Signature& signature, Anchors anchors, size_t position)
+	{
+		const uint8_t first = signature.bytes[anchors.first];
+		const uint8_t last = signature.bytes[anchors.last];
+
+		for (; position + signature.size() <= size; position++)
+		{
+			if (data[position + anchors.first] == first && data[position + anchors.last] == last && verifyScalar(data + position, signature, 0))
+				return position;
+		}
+		return PatternScanner::NOT_FOUND;
+	}
+
+	void markScalar(const uint8_t* data, size_t size, const PatternScanner::AnchorSet& set, uint64_t* marks, size_t position)
+	{
+		for (; position < size; position++)
+		{
+			if (set.contains(data[position]))
+				marks[position / 64] |= 1ull << (position % 64);
+		}
+	}
+
+	void markPairsScalar(const uint8_t* data, size_t size, size_t readable, const PatternScanner::AnchorSet& first, const PatternScanner::AnchorSet& second, uint64_t* marks, size_t position)
+	{
+		for (; position < size && position + 1 < readable; position++)
+		{
+			if (first.contains(data[position]) && second.contains(data[position + 1]))
+				marks[position / 64] |= 1ull << (position % 64);
+		}
+	}
+
+#if PATTERN_X86
+
+	PATTERN_TARGET("sse4.2")
+	bool verifySSE42(const uint8_t* data, const Signature& signature)
+	{
+		size_t i = 0;
+		for (; i + 16 <= signature.size(); i += 16)
+		{
+			const __m128i diff = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature.bytes.data() + i)));
+			if (!_mm_testz_si128(diff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature.mask.data() + i))))
+				return false;
+		}
+		return verifyScalar(data, signature, i);
+	}
+
+	PATTERN_TARGET("sse4.2")
+	size_t findSSE42(const uint8_t* data, size_t size, const Signature& signature, Anchors anchors)
+	{
+		const __m128i first = _mm_set1_epi8(static_cast<char>(signature.bytes[anchors.first]));
+		const __m128i last = _mm_set1_epi8(static_cast<char>(signature.bytes[anchors.last]));
+		const size_t length = signature.size();
+
+		size_t i = 0;
+		for (; i + anchors.last + 16 <= size; i += 16)
+		{
+			const __m128i eqFirst = _mm_cmpeq_epi8(first, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + anchors.first)));
+			const __m128i eqLast = _mm_cmpeq_epi8(last, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + anchors.last)));
+
+			for (uint32_t bits = _mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast)); bits; bits &= bits - 1)
+			{
+				const size_t position = i + std::countr_zero(bits);
+				if (position + length <= size && verifySSE42(data + position, signature))
+					return position;
+			}
+		}
+		return findScalar(data, size, signature, anchors, i);
+	}
+
+	PATTERN_TARGET("avx2")
+	bool verifyAVX2(const uint8_t* data, const Signature& signature)
+	{
+		size_t i = 0;
+		for (; i + 32 <= signature.size(); i += 32)
+		{
+			const __m256i diff = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(signature.bytes.data() + i)));
+			if (!_mm256_testz_si256(diff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(signature.mask.data() + i))))
+				return false;
+		}
+		return verifyScalar(data, signature, i);
+	}
+
+	PATTERN_TARGET("avx2")
+	size_t findAVX2(const uint8_t* data, size_t size, const Signature& signature, Anchors anchors)
+	{
+		const __m256i first = _mm256_set1_epi8(static_cast<char>(signature.bytes[anchors.first]));
+		const __m256i last = _mm256_set1_epi8(static_cast<char>(signature.bytes[anchors.last]));
+		const size_t length = signature.size();
+
+		size_t i = 0;
+		for (; i + anchors.last + 32 <= size; i += 32)
+		{
+			const __m256i eqFirst = _mm256_cmpeq_epi8(first, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + anchors.first)));
+			const __m256i eqLast = _mm256_cmpeq_epi8(last, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + anchors.last)));
+
+			for (uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(eqFirst, eqLast))); bits; bits &= bits - 1)
+			{
+				const size_t position = i + std::countr_zero(bits);
+				if (position + length <= size && verifyAVX2(data + position, signature))
+					return position;
+			}
+		}
+		return findScalar(data, size, signature, anchors, i);
+	}
+
+	PATTERN_TARGET("avx512f,avx512bw")
+	bool verifyAVX512(const uint8_t* data, const Signature& signature)
+	{
+		// masked loads never touch the bytes past the signature, so no scalar tail is needed
+		for (size_t i = 0; i < signature.size(); i += 64)
+		{
+			const size_t remaining = signature.size() - i;
+			const __mmask64 valid = remaining >= 64 ? ~0ull : (1ull << remaining) - 1;
+
+			const __m512i bytes = _mm512_maskz_loadu_epi8(valid, data + i);
+			const __m512i pattern = _mm512_maskz_loadu_epi8(valid, signature.bytes.data() + i);
+			const __mmask64 fixed = _mm512_test_epi8_mask(_mm512_maskz_loadu_epi8(valid, signature.mask.data() + i), _mm512_set1_epi8(-1));
+
+			if (_mm512_mask_cmpneq_epi8_mask(fixed, bytes, pattern))
+				return false;
+		}
+		return true;
+	}
+
+	PATTERN_TARGET("avx512f,avx512bw")
+	size_t findAVX512(const uint8_t* data, size_t size, const Signature& signature, Anchors anchors)
+	{
+		const __m512i first = _mm512_set1_epi8(static_cast<char>(signature.bytes[anchors.first]));
+		const __m512i last = _mm512_set1_epi8(static_cast<char>(signature.bytes[anchors.last]));
+		const size_t length = signature.size();
+
+		size_t i = 0;
+		for (; i + anchors.last + 64 <= size; i += 64)
+		{
+			const __mmask64 eqFirst = _mm512_cmpeq_epi8_mask(first, _mm512_loadu_si512(data + i + anchors.first));
+			const __mmask64 eqLast = _mm512_mask_cmpeq_epi8_mask(eqFirst, last, _mm512_loadu_si512(data + i + anchors.last));
+
+			for (uint64_t bits = eqLast; bits; bits &= bits - 1)
+			{
+				const size_t position = i + std::countr_zero(bits);
+				if (position + length <= size && verifyAVX512(data + position, signature))
+					return position;
+			}
+		}
+		return findScalar(data, size, signature, anchors, i);
+	}
+
+	// Byte set lookup of 16 bytes: the low nibble picks the row of the byte in its half of the set, the high nibble the bit in it.
+	// Bit i of the result is set if byte i is in the set
+	PATTERN_TARGET("sse4.2")
+	inline uint32_t hitsSSE42(__m128i block, __m128i lowHalf, __m128i highHalf)
+	{
+		const __m128i bitOf = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+		// shuffle yields 0 for indices with bit 7 set, so every table only answers for its own half
+		const __m128i select = _mm_set1_epi8(static_cast<char>(0x8F));
+		const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+		const __m128i nibble = _mm_set1_epi8(0x0F);
+
+		const __m128i index = _mm_and_si128(block, select);
+		const __m128i row = _mm_or_si128(_mm_shuffle_epi8(lowHalf, index), _mm_shuffle_epi8(highHalf, _mm_xor_si128(index, flip)));
+		const __m128i bit = _mm_shuffle_epi8(bitOf, _mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit)));
+	}
+
+	PATTERN_TARGET("sse4.2")
+	void markSSE42(const uint8_t* data, size_t size, const PatternScanner::AnchorSet& set, uint64_t* marks)
+	{
+		const __m128i lowHalf = _mm_load_si128(reinterpret_cast<const __m128i*>(set.lowHalf));
+		const __m128i highHalf = _mm_load_si128(reinterpret_cast<const __m128i*>(set.highHalf));
+
+		size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			const uint32_t hits = hitsSSE42(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), lowHalf, highHalf);
+			marks[i / 64] |= static_cast<uint64_t>(hits) << (i % 64);
+		}
+		markScalar(data, size, set, marks, i);
+	}
+
+	// Both lookups in one pass, the second one on the same block shifted by a byte
+	PATTERN_TARGET("sse4.2")
+	void markPairsSSE42(const uint8_t* data, size_t size, size_t readable, const PatternScanner::AnchorSet& first, const PatternScanner::AnchorSet& second, uint64_t* marks)
+	{
+		const __m128i firstLow = _mm_load_si128(reinterpret_cast<const __m128i*>(first.lowHalf));
+		const __m128i firstHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(first.highHalf));
+		const __m128i secondLow = _mm_load_si128(reinterpret_cast<const __m128i*>(second.lowHalf));
+		const __m128i secondHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(second.highHalf));
+
+		size_t i = 0;
+		for (; i + 16 <= size && i + 17 <= readable; i += 16)
+		{
+			const uint32_t hits = hitsSSE42(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), firstLow, firstHigh)
+				& hitsSSE42(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1)), secondLow, secondHigh);
+			marks[i / 64] |= static_cast<uint64_t>(hits) << (i % 64);
+		}
+		markPairsScalar(data, size, readable, first, second, marks, i);
+	}
+
+	// Same as hitsSSE42, the tables are repeated in both lanes
+	PATTERN_TARGET("avx2")
+	inline uint32_t hitsAVX2(__m256i block, __m256i lowHalf, __m256i highHalf)
+	{
+		const __m256i bitOf = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+		const __m256i select = _mm256_set1_epi8(static_cast<char>(0x8F));
+		const __m256i flip = _mm256_set1_epi8(static_cast<char>(0x80));
+		const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+		const __m256i index = _mm256_and_si256(block, select);
+		const __m256i row = _mm256_or_si256(_mm256_shuffle_epi8(lowHalf, index), _mm256_shuffle_epi8(highHalf, _mm256_xor_si256(index, flip)));
+		const __m256i bit = _mm256_shuffle_epi8(bitOf, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+		return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit)));
+	}
+
+	PATTERN_TARGET("avx2")
+	void markAVX2(const uint8_t* data, size_t size, const PatternScanner::AnchorSet& set, uint64_t* marks)
+	{
+		const __m256i lowHalf = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.lowHalf)));
+		const __m256i highHalf = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.highHalf)));
+
+		size_t i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			const uint32_t hits = hitsAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), lowHalf, highHalf);
+			marks[i / 64] |= static_cast<uint64_t>(hits) << (i % 64);
+		}
+		markScalar(data, size, set, marks, i);
+	}
+
+	PATTERN_TARGET("avx2")
+	void markPairsAVX2(const uint8_t* data, size_t size, size_t readable, const PatternScanner::AnchorSet& first, const PatternScanner::AnchorSet& second, uint64_t* marks)
+	{
+		const __m256i firstLow = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(first.lowHalf)));
+		const __m256i firstHigh = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(first.highHalf)));
+		const __m256i secondLow = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(second.lowHalf)));
+		const __m256i secondHigh = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(second.highHalf)));
+
+		size_t i = 0;
+		for (; i + 32 <= size && i + 33 <= readable; i += 32)
+		{
+			const uint32_t hits = hitsAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), firstLow, firstHigh)
+				& hitsAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1)), secondLow, secondHigh);
+			marks[i / 64] |= static_cast<uint64_t>(hits) << (i % 64);
+		}
+		markPairsScalar(data, size, readable, first, second, marks, i);
+	}
+
+	// Same lookup 64 bytes at a time, the compare goes straight into a mask register
+	PATTERN_TARGET("avx512f,avx512bw")
+	inline uint64_t hitsAVX512(__m512i block, __m512i lowHalf, __m512i highHalf)
+	{
+		const __m512i bitOf = _mm512_broadcast_i32x4(_mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128));
+		const __m512i select = _mm512_set1_epi8(static_cast<char>(0x8F));
+		const __m512i flip = _mm512_set1_epi8(static_cast<char>(0x80));
+		const __m512i nibble = _mm512_set1_epi8(0x0F);
+
+		const __m512i index = _mm512_and_si512(block, select);
+		const __m512i row = _mm512_or_si512(_mm512_shuffle_epi8(lowHalf, index), _mm512_shuffle_epi8(highHalf, _mm512_xor_si512(index, flip)));
+		const __m512i bit = _mm512_shuffle_epi8(bitOf, _mm512_and_si512(_mm512_srli_epi16(block, 4), nibble));
+		return _mm512_test_epi8_mask(row, bit);
+	}
+
+	PATTERN_TARGET("avx512f,avx512bw")
+	void markPairsAVX512(const uint8_t* data, size_t size, size_t readable, const PatternScanner::AnchorSet& first, const PatternScanner::AnchorSet& second, uint64_t* marks)
+	{
+		const __m512i firstLow = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(first.lowHalf)));
+		const __m512i firstHigh = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(first.highHalf)));
+		const __m512i secondLow = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(second.lowHalf)));
+		const __m512i secondHigh = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(second.highHalf)));
+
+		size_t i = 0;
+		for (; i + 64 <= size && i + 65 <= readable; i += 64)
+			marks[i / 64] |= hitsAVX512(_mm512_loadu_si512(data + i), firstLow, firstHigh) & hitsAVX512(_mm512_loadu_si512(data + i + 1), secondLow, secondHigh);
+		markPairsScalar(data, size, readable, first, second, marks, i);
+	}
+
+	ScanLevel detect()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		const bool sse42 = info[2] & (1 << 20);
+		const bool osxsave = info[2] & (1 << 27);
+		if (!osxsave || maxLeaf < 7)
+			return sse42 ? ScanLevel::SSE42 : ScanLevel::Scalar;
+
+		// the OS has to save the ymm/zmm registers on context switches
+		const unsigned long long xcr0 = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		const bool avx2 = (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+		const bool avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)) && (xcr0 & 0xE6) == 0xE6;
+#else
+		__builtin_cpu_init();
+		const bool sse42 = __builtin_cpu_supports("sse4.2");
+		const bool avx2 = __builtin_cpu_supports("avx2");
+		const bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+		if (avx512)
+			return ScanLevel::AVX512;
+		if (avx2)
+			return ScanLevel::AVX2;
+		if (sse42)
+			return ScanLevel::SSE42;
+		return ScanLevel::Scalar;
+	}
+
+#else
+
+	ScanLevel detect()
+	{
+		return ScanLevel::Scalar;
+	}
+
+#endif
+}
+
+ScanLevel PatternScanner::detectLevel()
+{
+	static const ScanLevel level = detect();
+	return level;
+}
+
+const char* PatternScanner::levelName(ScanLevel level)
+{
+	switch (level)
+	{
+	case ScanLevel::SSE42: return "sse4.2";
+	case ScanLevel::AVX2: return "avx2";
+	case ScanLevel::AVX512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+size_t PatternScanner::findFirst(const uint8_t* data, size_t size, const Signature& signature, ScanLevel level)
+{
+	if (!signature.size() || signature.size() > size)
+		return NOT_FOUND;
+
+	Anchors anchors{ NOT_FOUND, NOT_FOUND };
+	for (size_t i = 0; i < signature.size(); i++)
+	{
+		if (!signature.mask[i])
+			continue;
+
+		if (anchors.first == NOT_FOUND)
+			anchors.first = i;
+		anchors.last = i;
+	}
+
+	// only wildcards, matches right at the start
+	if (anchors.first == NOT_FOUND)
+		return 0;
+
+	// never run a kernel the CPU does not have, even if it was asked for
+	if (level > detectLevel())
+		level = detectLevel();
+
+#if PATTERN_X86
+	switch (level)
+	{
+	case ScanLevel::AVX512: return findAVX512(data, size, signature, anchors);
+	case ScanLevel::AVX2: return findAVX2(data, size, signature, anchors);
+	case ScanLevel::SSE42: return findSSE42(data, size, signature, anchors);
+	default: break;
+	}
+#endif
+	return findScalar(data, size, signature, anchors, 0);
+}
+
+void PatternScanner::markAnchors(const uint8_t* data, size_t size, const AnchorSet& set, uint64_t* marks, ScanLevel level)
+{
+#if PATTERN_X86
+	switch (level)
+	{
+	// 64 byte shuffles would only save the second half of a movemask, AVX2 is as fast here
+	case ScanLevel::AVX512:
+	case ScanLevel::AVX2: return markAVX2(data, size, set, marks);
+	case ScanLevel::SSE42: return markSSE42(data, size, set, marks);
+	default: break;
+	}
+#endif
+	markScalar(data, size, set, marks, 0);
+}
+
+void PatternScanner::markPairs(const uint8_t* data, size_t size, size_t readable, const AnchorSet& first, const AnchorSet& second, uint64_t* marks, ScanLevel level)
+{
+#if PATTERN_X86
+	switch (level)
+	{
+	case ScanLevel::AVX512: return markPairsAVX512(data, size, readable, first, second, marks);
+	case ScanLevel::AVX2: return markPairsAVX2(data, size, readable, first, second, marks);
+	case ScanLevel::SSE42: return markPairsSSE42(data, size, readable, first, second, marks);
+	default: break;
+	}
+#endif
+	markPairsScalar(data, size, readable, first, second, marks, 0);
+}
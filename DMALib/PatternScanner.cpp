@@ -0,0 +1,452 @@
+#include "PatternScanner.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PATTERN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// rough frequency class of a byte in x64 code, lower is rarer and makes a better anchor
+	int byteCommonness(uint8_t value)
+	{
+		switch (value)
+		{
+		case 0x00: case 0xFF: case 0xCC:
+			return 4;
+		case 0x48: case 0x89: case 0x8B: case 0x4C: case 0x24: case 0x0F: case 0xE8:
+		case 0x83: case 0x8D: case 0x44: case 0x01: case 0x45: case 0xC0: case 0x85:
+			return 3;
+		case 0x49: case 0x4D: case 0x33: case 0xC3: case 0x74: case 0x75: case 0xEB:
+		case 0x08: case 0x10: case 0x20: case 0x40: case 0x41:
+			return 2;
+		default:
+			return 1;
+		}
+	}
+
+	// Start positions [begin, end) of a region, the data of a shard reaches overlap bytes further
+	struct Shard
+	{
+		size_t region;
+		size_t begin;
+		size_t end;
+		uint64_t address;
+	};
+
+	std::vector<Shard> makeShards(const std::vector<ScanRegion>& regions, size_t shardSize)
+	{
+		std::vector<Shard> shards;
+		for (size_t r = 0; r < regions.size(); r++)
+		{
+			for (size_t begin = 0; begin < regions[r].size; begin += shardSize)
+				shards.push_back(Shard{ r, begin, std::min(begin + shardSize, regions[r].size), regions[r].address + begin });
+		}
+
+		// low addresses first, so the early shards find the match the later ones get skipped for
+		std::sort(shards.begin(), shards.end(), [](const Shard& a, const Shard& b) { return a.address < b.address; });
+		return shards;
+	}
+
+	// Runs fn for every shard index on the pool and the calling thread, rethrows the first exception of a job
+	template <typename Fn>
+	void runShards(ThreadPool& pool, size_t count, Fn&& fn)
+	{
+		std::atomic<size_t> next{ 0 };
+		auto work = [&]
+		{
+			for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;)
+				fn(i);
+		};
+
+		std::vector<std::future<void>> jobs;
+		const size_t helpers = std::min(pool.size(), count) - (count ? 1 : 0);
+		for (size_t i = 0; i < helpers; i++)
+			jobs.push_back(pool.submit(work));
+
+		work();
+		for (auto& job : jobs)
+			job.get();
+	}
+
+	void lowerTo(std::atomic<uint64_t>& value, uint64_t candidate)
+	{
+		uint64_t current = value.load(std::memory_order_relaxed);
+		while (candidate < current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed));
+	}
+
+	int hexValue(char c)
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+}
+
+Signature Signature::fromIDA(const std::string& signature)
+{
+	Signature result;
+	size_t i = 0;
+	while (i < signature.length())
+	{
+		if (isspace(static_cast<unsigned char>(signature[i])))
+		{
+			i++;
+			continue;
+		}
+
+		if (signature[i] == '?')
+		{
+			result.bytes.push_back(0);
+			result.mask.push_back(0x00);
+			i += (i + 1 < signature.length() && signature[i + 1] == '?') ? 2 : 1;
+			continue;
+		}
+
+		const int high = hexValue(signature[i]);
+		const int low = i + 1 < signature.length() ? hexValue(signature[i + 1]) : -1;
+		if (high < 0 || low < 0)
+			return {};
+
+		result.bytes.push_back(static_cast<uint8_t>(high << 4 | low));
+		result.mask.push_back(0xFF);
+		i += 2;
+	}
+	return result;
+}
+
+Signature Signature::fromMask(const char* pattern, const std::string& mask)
+{
+	Signature result;
+	result.bytes.assign(reinterpret_cast<const uint8_t*>(pattern), reinterpret_cast<const uint8_t*>(pattern) + mask.length());
+	result.mask.resize(mask.length());
+	for (size_t i = 0; i < mask.length(); i++)
+		result.mask[i] = mask[i] == 'x' ? 0xFF : 0x00;
+	return result;
+}
+
+size_t Signature::hash() const
+{
+	// FNV-1a
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < bytes.size(); i++)
+	{
+		hash = (hash ^ (bytes[i] & mask[i])) * 0x100000001B3ull;
+		hash = (hash ^ mask[i]) * 0x100000001B3ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+bool Signature::operator==(const Signature& other) const
+{
+	if (size() != other.size() || mask != other.mask)
+		return false;
+
+	for (size_t i = 0; i < bytes.size(); i++)
+	{
+		if ((bytes[i] ^ other.bytes[i]) & mask[i])
+			return false;
+	}
+	return true;
+}
+
+size_t PatternScanner::pickAnchor(const Signature& signature)
+{
+	size_t anchor = NOT_FOUND;
+	int best = INT32_MAX;
+	for (size_t i = 0; i < signature.size(); i++)
+	{
+		if (!signature.mask[i])
+			continue;
+
+		// a pair filters about 256 times better than a single byte, any pair wins over every single byte
+		const bool paired = i + 1 < signature.size() && signature.mask[i + 1];
+		const int commonness = byteCommonness(signature.bytes[i]) + (paired ? byteCommonness(signature.bytes[i + 1]) : 16);
+		if (commonness < best)
+		{
+			best = commonness;
+			anchor = i;
+		}
+	}
+	return anchor;
+}
+
+void PatternScanner::AnchorSet::add(uint8_t value)
+{
+	uint8_t* half = value < 0x80 ? lowHalf : highHalf;
+	half[value & 0x0F] |= static_cast<uint8_t>(1 << ((value >> 4) & 7));
+}
+
+PatternScanner::PatternScanner(std::vector<Signature> signatures)
+	: byAnchor(256)
+{
+	this->signatures.reserve(signatures.size());
+	for (auto& signature : signatures)
+	{
+		const size_t anchor = pickAnchor(signature);
+		const bool paired = anchor != NOT_FOUND && anchor + 1 < signature.size() && signature.mask[anchor + 1];
+		if (anchor != NOT_FOUND)
+		{
+			const uint8_t value = signature.bytes[anchor];
+			anchors.add(value);
+			byAnchor[value].push_back(static_cast<uint32_t>(this->signatures.size()));
+
+			if (paired)
+				seconds.add(signature.bytes[anchor + 1]);
+			else
+				pairFilter = false;
+		}
+		this->signatures.push_back(Compiled{ std::move(signature), anchor, paired });
+	}
+}
+
+bool PatternScanner::matches(const uint8_t* data, const Signature& signature)
+{
+	const size_t length = signature.size();
+	const uint8_t* bytes = signature.bytes.data();
+	const uint8_t* mask = signature.mask.data();
+	size_t i = 0;
+
+#if PATTERN_SSE2
+	// (data ^ pattern) & mask has to be zero for every byte
+	for (; i + 16 <= length; i += 16)
+	{
+		const __m128i diff = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i)));
+		const __m128i masked = _mm_and_si128(diff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(masked, _mm_setzero_si128())) != 0xFFFF)
+			return false;
+	}
+#endif
+
+	for (; i < length; i++)
+	{
+		if ((data[i] ^ bytes[i]) & mask[i])
+			return false;
+	}
+	return true;
+}
+
+std::vector<size_t> PatternScanner::scanFirst(const uint8_t* data, size_t size) const
+{
+	std::vector<size_t> result(signatures.size(), NOT_FOUND);
+	size_t remaining = 0;
+
+	for (size_t i = 0; i < signatures.size(); i++)
+	{
+		// a signature of wildcards only matches right at the start, an empty one never
+		if (signatures[i].anchor == NOT_FOUND)
+		{
+			if (signatures[i].signature.size() && signatures[i].signature.size() <= size)
+				result[i] = 0;
+		}
+		else
+			remaining++;
+	}
+
+	// verifies every signature anchored at data[position], returns true once everything is resolved
+	auto check = [&](size_t position)
+	{
+		for (const uint32_t index : byAnchor[data[position]])
+		{
+			if (result[index] != NOT_FOUND)
+				continue;
+
+			const Compiled& compiled = signatures[index];
+			if (position < compiled.anchor)
+				continue;
+
+			const size_t start = position - compiled.anchor;
+			if (start + compiled.signature.size() > size)
+				continue;
+
+			// the second byte set only says some signature has this byte there, not this one
+			if (compiled.paired && data[position + 1] != compiled.signature.bytes[compiled.anchor + 1])
+				continue;
+
+			if (matches(data + start, compiled.signature))
+			{
+				result[index] = start;
+				if (!--remaining)
+					return true;
+			}
+		}
+		return false;
+	};
+
+	if (!remaining)
+		return result;
+
+	const ScanLevel level = detectLevel();
+	uint64_t marks[ANCHOR_CHUNK / 64];
+	for (size_t chunk = 0; chunk < size; chunk += ANCHOR_CHUNK)
+	{
+		const size_t length = std::min(ANCHOR_CHUNK, size - chunk);
+		std::fill(std::begin(marks), std::end(marks), 0);
+		if (pairFilter)
+			markPairs(data + chunk, length, size - chunk, anchors, seconds, marks, level);
+		else
+			markAnchors(data + chunk, length, anchors, marks, level);
+
+		for (size_t word = 0; word < (length + 63) / 64; word++)
+		{
+			for (uint64_t bits = marks[word]; bits; bits &= bits - 1)
+			{
+				if (check(chunk + word * 64 + std::countr_zero(bits)))
+					return result;
+			}
+		}
+	}
+	return result;
+}
+
+ScanMatch PatternScanner::findLowest(const std::vector<ScanRegion>& regions, const Signature& signature, ThreadPool& pool, size_t shardSize)
+{
+	if (!signature.size())
+		return {};
+
+	const size_t overlap = signature.size() - 1;
+	const auto shards = makeShards(regions, std::max<size_t>(shardSize, 1));
+
+	std::atomic<uint64_t> best{ UINT64_MAX };
+	std::vector<size_t> offsets(shards.size(), NOT_FOUND);
+
+	runShards(pool, shards.size(), [&](size_t i)
+	{
+		const Shard& shard = shards[i];
+		if (shard.address >= best.load(std::memory_order_relaxed))
+			return;
+
+		const ScanRegion& region = regions[shard.region];
+		const size_t length = std::min(shard.end + overlap, region.size) - shard.begin;
+		const size_t offset = findFirst(region.data + shard.begin, length, signature);
+		if (offset == NOT_FOUND)
+			return;
+
+		offsets[i] = shard.begin + offset;
+		lowerTo(best, shard.address + offset);
+	});
+
+	ScanMatch match;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		if (offsets[i] == NOT_FOUND)
+			continue;
+
+		const uint64_t address = regions[shards[i].region].address + offsets[i];
+		if (!match.found() || address < match.address)
+			match = ScanMatch{ shards[i].region, offsets[i], address };
+	}
+	return match;
+}
+
+std::vector<ScanMatch> PatternScanner::scanLowest(const std::vector<ScanRegion>& regions, ThreadPool& pool, size_t shardSize) const
+{
+	std::vector<ScanMatch> result(signatures.size());
+
+	size_t longest = 0;
+	for (const auto& compiled : signatures)
+		longest = std::max(longest, compiled.signature.size());
+
+	if (!longest)
+		return result;
+
+	const size_t overlap = longest - 1;
+	const auto shards = makeShards(regions, std::max<size_t>(shardSize, 1));
+
+	std::mutex mutex;
+	// highest address any signature still needs a match below, UINT64_MAX while one is unresolved
+	std::atomic<uint64_t> bound{ UINT64_MAX };
+
+	runShards(pool, shards.size(), [&](size_t i)
+	{
+		const Shard& shard = shards[i];
+		if (shard.address >= bound.load(std::memory_order_relaxed))
+			return;
+
+		const ScanRegion& region = regions[shard.region];
+		const size_t length = std::min(shard.end + overlap, region.size) - shard.begin;
+		const auto offsets = scanFirst(region.data + shard.begin, length);
+
+		std::lock_guard lock(mutex);
+		uint64_t highest = 0;
+		for (size_t s = 0; s < offsets.size(); s++)
+		{
+			if (offsets[s] != NOT_FOUND)
+			{
+				const uint64_t address = shard.address + offsets[s];
+				if (!result[s].found() || address < result[s].address)
+					result[s] = ScanMatch{ shard.region, shard.begin + offsets[s], address };
+			}
+			highest = result[s].found() ? std::max(highest, result[s].address) : UINT64_MAX;
+		}
+		bound.store(highest, std::memory_order_relaxed);
+	});
+	return result;
+}
+
+MatchRange::MatchRange(std::vector<ScanRegion> regions, Signature signature)
+	: regions(std::move(regions)), signature(std::move(signature))
+{
+	order.resize(this->regions.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return this->regions[a].address < this->regions[b].address; });
+}
+
+std::vector<ScanMatch> MatchRange::collect(size_t limit) const
+{
+	std::vector<ScanMatch> matches;
+	for (auto it = begin(); it != end() && matches.size() < limit; ++it)
+		matches.push_back(*it);
+	return matches;
+}
+
+MatchRange::iterator::iterator(const MatchRange* range)
+	: range(range)
+{
+	find(0);
+}
+
+void MatchRange::iterator::find(size_t offset)
+{
+	for (; position < range->order.size(); position++, offset = 0)
+	{
+		const size_t index = range->order[position];
+		const ScanRegion& region = range->regions[index];
+		if (offset >= region.size)
+			continue;
+
+		const size_t found = PatternScanner::findFirst(region.data + offset, region.size - offset, range->signature);
+		if (found != PatternScanner::NOT_FOUND)
+		{
+			match = ScanMatch{ index, offset + found, region.address + offset + found };
+			return;
+		}
+	}
+	match = ScanMatch{};
+}
+
+MatchRange::iterator& MatchRange::iterator::operator++()
+{
+	if (match.found())
+		find(match.offset + 1);
+	return *this;
+}
+
+bool MatchRange::iterator::operator==(const iterator& other) const
+{
+	if (!match.found() || !other.match.found())
+		return match.found() == other.match.found();
+
+	return match.region == other.match.region && match.offset == other.match.offset;
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * \brief A byte signature with a per byte mask, 0xFF compares the byte, 0x00 is a wildcard.
+ */
+struct Signature
+{
+	std::vector<uint8_t> bytes;
+	std::vector<uint8_t> mask;
+
+	/**
+	 * \brief parses an IDA style signature like "48 8B 05 ? ? ? ? 48 85 C0", "??" is accepted as wildcard too
+	 */
+	static Signature fromIDA(const std::string& signature);
+
+	/**
+	 * \brief converts the pattern + "xx???x" mask pair used by DMAHandler::patternScan
+	 */
+	static Signature fromMask(const char* pattern, const std::string& mask);
+
+	size_t size() const { return bytes.size(); }
+
+	// Hash over the fixed bytes and the mask, wildcard bytes do not matter
+	size_t hash() const;
+
+	// Same fixed bytes and mask, no matter what the wildcard bytes hold
+	bool operator==(const Signature& other) const;
+};
+
+/**
+ * \brief A buffer to scan together with the address its first byte was read from
+ */
+struct ScanRegion
+{
+	const uint8_t* data;
+	size_t size;
+	uint64_t address;
+};
+
+/**
+ * \brief A match inside a list of regions
+ */
+struct ScanMatch
+{
+	size_t region = SIZE_MAX;
+	size_t offset = 0;
+	uint64_t address = 0;
+
+	bool found() const { return region != SIZE_MAX; }
+};
+
+/**
+ * \brief SIMD width of the scan kernels, picked at runtime via CPUID
+ */
+enum class ScanLevel
+{
+	Scalar,
+	SSE42,
+	AVX2,
+	AVX512,
+};
+
+/**
+ * \brief Resolves many signatures in a single pass over a buffer.
+ * Every signature gets an anchor, its rarest pair of adjacent fixed bytes (its rarest fixed byte if it has no such pair).
+ * The buffer is searched for all first and all second anchor bytes at once with a SIMD byte set lookup each,
+ * only positions that hit both sets are verified against the signatures anchored on them.
+ * The lookups cost the same for any amount of anchors, the verification grows with how often the anchors
+ * occur in the buffer. One signature without a pair turns the second lookup off for the whole scanner,
+ * with many signatures on common bytes findFirst per signature can be faster then.
+ */
+class PatternScanner
+{
+public:
+	static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+	// Amount of start positions one job of a sharded scan checks
+	static constexpr size_t DEFAULT_SHARD_SIZE = 1024 * 1024;
+
+	/**
+	 * \brief The distinct anchor bytes as two nibble tables, so membership of any byte is two table lookups.
+	 * Bit h of lowHalf[l] is set if byte (h << 4 | l) is an anchor, highHalf does the same for the bytes from 0x80 up.
+	 */
+	struct AnchorSet
+	{
+		alignas(16) uint8_t lowHalf[16] = {};
+		alignas(16) uint8_t highHalf[16] = {};
+
+		void add(uint8_t value);
+
+		bool contains(uint8_t value) const
+		{
+			const uint8_t bits = value < 0x80 ? lowHalf[value & 0x0F] : highHalf[value & 0x0F];
+			return bits >> ((value >> 4) & 7) & 1;
+		}
+	};
+
+private:
+	struct Compiled
+	{
+		Signature signature;
+		// offset of the anchor byte inside the signature, NOT_FOUND if the signature is all wildcards
+		size_t anchor;
+		// whether the byte after the anchor is fixed too
+		bool paired;
+	};
+
+	// Bytes one call of markAnchors looks at, marks are collected in 64 bit words
+	static constexpr size_t ANCHOR_CHUNK = 4096;
+
+	std::vector<Compiled> signatures;
+	// anchor byte value -> indices of the signatures anchored on it
+	std::vector<std::vector<uint32_t>> byAnchor;
+	AnchorSet anchors;
+	// the bytes after the anchors, only used if every anchored signature is paired
+	AnchorSet seconds;
+	bool pairFilter = true;
+
+	static size_t pickAnchor(const Signature& signature);
+
+	// Sets bit i % 64 of marks[i / 64] for every data[i] in the set, size is at most ANCHOR_CHUNK. Runs the kernel of the given level
+	static void markAnchors(const uint8_t* data, size_t size, const AnchorSet& set, uint64_t* marks, ScanLevel level);
+
+	// Same as markAnchors for the positions i with data[i] in first and data[i + 1] in second, data holds readable bytes
+	static void markPairs(const uint8_t* data, size_t size, size_t readable, const AnchorSet& first, const AnchorSet& second, uint64_t* marks, ScanLevel level);
+
+public:
+	explicit PatternScanner(std::vector<Signature> signatures);
+
+	size_t count() const { return signatures.size(); }
+
+	/**
+	 * \brief scans the buffer once
+	 * \return the offset of the first match of every signature, NOT_FOUND for the ones without match
+	 */
+	std::vector<size_t> scanFirst(const uint8_t* data, size_t size) const;
+
+	// Whether the signature matches at data, data has to hold at least signature.size() bytes
+	static bool matches(const uint8_t* data, const Signature& signature);
+
+	/**
+	 * \brief finds the first match of a single signature. Candidates are prefiltered on the first and last
+	 * fixed byte 16/32/64 positions at a time and verified with a masked compare of the same width.
+	 * \param level kernel to use, defaults to the best one the CPU supports
+	 * \return offset of the match or NOT_FOUND
+	 */
+	static size_t findFirst(const uint8_t* data, size_t size, const Signature& signature, ScanLevel level = detectLevel());
+
+	// Best kernel the running CPU (and OS) supports, detected once
+	static ScanLevel detectLevel();
+
+	static const char* levelName(ScanLevel level);
+
+	/**
+	 * \brief splits the regions into shards that overlap by the signature length - 1 and scans them on the pool.
+	 * Shards starting above an already found match are skipped, the result is always the lowest address match.
+	 * The calling thread works on shards too, do not call it from a job of the same pool.
+	 */
+	static ScanMatch findLowest(const std::vector<ScanRegion>& regions, const Signature& signature, ThreadPool& pool, size_t shardSize = DEFAULT_SHARD_SIZE);
+
+	/**
+	 * \brief sharded version of scanFirst, see findLowest
+	 * \return the lowest address match of every signature
+	 */
+	std::vector<ScanMatch> scanLowest(const std::vector<ScanRegion>& regions, ThreadPool& pool, size_t shardSize = DEFAULT_SHARD_SIZE) const;
+};
+
+/**
+ * \brief Lazily walks all matches of a signature over a list of regions in address order.
+ * Every increment scans only up to the next match, so stopping early skips the rest of the regions.
+ * The regions are not copied, they have to outlive the range.
+ */
+class MatchRange
+{
+	std::vector<ScanRegion> regions;
+	// indices into regions, sorted by address
+	std::vector<size_t> order;
+	Signature signature;
+
+public:
+	class iterator
+	{
+		const MatchRange* range = nullptr;
+		// index into order of the region the current match is in
+		size_t position = 0;
+		ScanMatch match;
+
+		// moves to the first match at or after offset in the current region or the ones following it
+		void find(size_t offset);
+
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = ScanMatch;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const ScanMatch*;
+		using reference = const ScanMatch&;
+
+		iterator() = default;
+		explicit iterator(const MatchRange* range);
+
+		reference operator*() const { return match; }
+		pointer operator->() const { return &match; }
+
+		iterator& operator++();
+		void operator++(int) { ++*this; }
+
+		bool operator==(const iterator& other) const;
+	};
+
+	MatchRange(std::vector<ScanRegion> regions, Signature signature);
+
+	iterator begin() const { return iterator(this); }
+	iterator end() const { return iterator(); }
+
+	// Runs the scan to the end, or until limit matches were found
+	std::vector<ScanMatch> collect(size_t limit = SIZE_MAX) const;
+};
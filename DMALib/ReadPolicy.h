@@ -0,0 +1,46 @@
+#pragma once
+#include "DMABackend.h"
+
+/**
+ * \brief How reads are issued: the VMMDLL_FLAG_* of plain reads and scatter handles and whether the
+ * PageCacheBackend of the handler may serve them. Set per DMAHandler, per ScatterBatch or per call.
+ */
+struct ReadPolicy
+{
+	// VMMDLL_FLAG_* of plain reads
+	ULONG64 flags = VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_NOPAGING | VMMDLL_FLAG_ZEROPAD_ON_FAIL | VMMDLL_FLAG_NOPAGING_IO;
+	// VMMDLL_FLAG_* scatter handles are created and cleared with
+	DWORD scatterFlags = VMMDLL_FLAG_NOCACHE;
+	// whether the library page cache may serve and keep the reads, see DMAHandler::enableReadCache
+	bool pageCache = true;
+
+	// Flags handed to the backend for a plain read
+	ULONG64 readFlags() const { return pageCache ? flags : flags | DMALIB_FLAG_NOPAGECACHE; }
+
+	bool operator==(const ReadPolicy& other) const = default;
+
+	// The default: straight from the device, paged out memory is skipped, failed pages come back zeroed
+	static constexpr ReadPolicy realtime()
+	{
+		return ReadPolicy{};
+	}
+
+	// Like realtime, but never served from the library page cache either. For values that have to be current
+	static constexpr ReadPolicy freshest()
+	{
+		return ReadPolicy{ VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_NOPAGING | VMMDLL_FLAG_ZEROPAD_ON_FAIL | VMMDLL_FLAG_NOPAGING_IO | VMMDLL_FLAG_NO_PREDICTIVE_READ,
+			VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_NO_PREDICTIVE_READ, false };
+	}
+
+	// Memory that rarely changes (code, vtables, static data): MemProcFS and the page cache may both serve it
+	static constexpr ReadPolicy cachedStatic()
+	{
+		return ReadPolicy{ VMMDLL_FLAG_NOPAGING | VMMDLL_FLAG_ZEROPAD_ON_FAIL | VMMDLL_FLAG_NOPAGING_IO, 0, true };
+	}
+
+	// Everything that can be read: paged out memory is fetched from the pagefile, failures are reported instead of zero padded
+	static constexpr ReadPolicy forensicComplete()
+	{
+		return ReadPolicy{ VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_FORCECACHE_READ_DISABLE, VMMDLL_FLAG_NOCACHE | VMMDLL_FLAG_FORCECACHE_READ_DISABLE, false };
+	}
+};
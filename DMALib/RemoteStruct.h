@@ -0,0 +1,183 @@
+#pragma once
+#include "DMAHandler.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * \brief A field of a remote struct, the value of type T at offset from the base of the struct.
+ * Declare the fields of a struct once and read only the ones needed:
+ *
+ *	struct Player
+ *	{
+ *		using position = RemoteField<0x10, Vector3>;
+ *		using health = RemoteField<0x1C, int>;
+ *		using name = RemoteField<0x7F0, std::array<char, 32>>;
+ *	};
+ *
+ *	RemoteView<Player::position, Player::health> player;
+ *	player.read(DMA, address);
+ *	int health = player.get<Player::health>();
+ */
+template <ULONG64 Offset, typename T>
+struct RemoteField
+{
+	static_assert(std::is_trivially_copyable_v<T>, "remote reads copy raw memory, T has to be trivially copyable");
+
+	static constexpr ULONG64 offset = Offset;
+	using type = T;
+};
+
+/**
+ * \brief Read ranges of a set of fields, computed at compile time.
+ * Fields are sorted by offset and fields that overlap or touch are merged into one span. Gaps up to
+ * MAX_GAP bytes, the alignment padding between two fields, are merged as well since an extra read costs more than a few bytes.
+ * The spans are stored back to back in a buffer of BUFFER_SIZE bytes.
+ */
+template <typename... Fields>
+struct RemoteLayout
+{
+	static constexpr size_t FIELD_COUNT = sizeof...(Fields);
+	static constexpr ULONG64 MAX_GAP = 8;
+
+	struct Span
+	{
+		ULONG64 offset;
+		DWORD size;
+		// position of the span in the buffer
+		size_t buffer;
+	};
+
+	struct Layout
+	{
+		std::array<Span, FIELD_COUNT> spans{};
+		size_t spanCount = 0;
+		// position of every field in the buffer
+		std::array<size_t, FIELD_COUNT> fields{};
+		size_t bufferSize = 0;
+	};
+
+	static constexpr Layout compute()
+	{
+		constexpr std::array<ULONG64, FIELD_COUNT> offsets = { Fields::offset... };
+		constexpr std::array<size_t, FIELD_COUNT> sizes = { sizeof(typename Fields::type)... };
+
+		std::array<size_t, FIELD_COUNT> order{};
+		for (size_t i = 0; i < FIELD_COUNT; i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+		Layout layout{};
+		std::array<size_t, FIELD_COUNT> spanOf{};
+		for (const size_t field : order)
+		{
+			if (layout.spanCount && offsets[field] <= layout.spans[layout.spanCount - 1].offset + layout.spans[layout.spanCount - 1].size + MAX_GAP)
+			{
+				Span& span = layout.spans[layout.spanCount - 1];
+				span.size = static_cast<DWORD>(std::max(span.offset + span.size, offsets[field] + sizes[field]) - span.offset);
+			}
+			else
+				layout.spans[layout.spanCount++] = Span{ offsets[field], static_cast<DWORD>(sizes[field]), 0 };
+
+			spanOf[field] = layout.spanCount - 1;
+		}
+
+		for (size_t i = 0; i < layout.spanCount; i++)
+		{
+			layout.spans[i].buffer = layout.bufferSize;
+			layout.bufferSize += layout.spans[i].size;
+		}
+
+		for (size_t field = 0; field < FIELD_COUNT; field++)
+		{
+			const Span& span = layout.spans[spanOf[field]];
+			layout.fields[field] = span.buffer + (offsets[field] - span.offset);
+		}
+		return layout;
+	}
+
+	static constexpr Layout layout = compute();
+	static constexpr size_t SPAN_COUNT = layout.spanCount;
+	static constexpr size_t BUFFER_SIZE = layout.bufferSize;
+
+	// Index of Field in the field list
+	template <typename Field>
+	static constexpr size_t indexOf()
+	{
+		constexpr bool matches[] = { std::is_same_v<Field, Fields>... };
+		for (size_t i = 0; i < FIELD_COUNT; i++)
+		{
+			if (matches[i])
+				return i;
+		}
+		return FIELD_COUNT;
+	}
+};
+
+/**
+ * \brief The selected fields of one remote struct. Only the spans of those fields are read,
+ * so reading two fields of a 2KB struct transfers a few bytes instead of sizeof the whole struct.
+ * Trivially copyable, a view can be stored and copied like the struct it stands for.
+ */
+template <typename... Fields>
+class RemoteView
+{
+	static_assert(sizeof...(Fields) > 0, "a RemoteView needs at least one field");
+
+	using Layout = RemoteLayout<Fields...>;
+
+	std::array<uint8_t, Layout::BUFFER_SIZE> buffer{};
+
+public:
+	/**
+	 * \brief reads the fields of the struct at address, one blocking read if all fields share a span, one scatter round otherwise
+	 * \return false if the read or the scatter failed
+	 */
+	bool read(const DMAHandler& DMA, ULONG64 address)
+	{
+		if constexpr (Layout::SPAN_COUNT == 1)
+			return DMA.read(address + Layout::layout.spans[0].offset, reinterpret_cast<ULONG64>(buffer.data()), Layout::BUFFER_SIZE);
+		else
+		{
+			const auto handle = DMA.acquireScatterHandle();
+			if (!handle)
+				return false;
+
+			queue(DMA, handle, address);
+			return DMA.executeScatterRead(handle);
+		}
+	}
+
+	/**
+	 * \brief queues the spans of the struct at address on a scatter handle, e.g. to read many structs in one round.
+	 * The view must stay where it is until the handle was executed.
+	 */
+	void queue(const DMAHandler& DMA, VMMDLL_SCATTER_HANDLE handle, ULONG64 address)
+	{
+		buffer.fill(0);
+		for (size_t i = 0; i < Layout::SPAN_COUNT; i++)
+		{
+			const auto& span = Layout::layout.spans[i];
+			DMA.queueScatterReadEx(handle, address + span.offset, buffer.data() + span.buffer, span.size);
+		}
+	}
+
+	template <typename Field>
+	typename Field::type get() const
+	{
+		constexpr size_t index = Layout::template indexOf<Field>();
+		static_assert(index < sizeof...(Fields), "the field is not part of this view");
+
+		typename Field::type value;
+		memcpy(&value, buffer.data() + Layout::layout.fields[index], sizeof(value));
+		return value;
+	}
+
+	// Amount of reads or scatter entries a read issues
+	static constexpr size_t spanCount() { return Layout::SPAN_COUNT; }
+
+	// Bytes a read transfers
+	static constexpr size_t transferSize() { return Layout::BUFFER_SIZE; }
+};
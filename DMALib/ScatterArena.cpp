@@ -0,0 +1,68 @@
+#include "ScatterArena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr size_t MIN_BLOCK_SIZE = 0x1000;
+}
+
+ScatterArena::ScatterArena(size_t initialSize)
+{
+	if (initialSize)
+		addBlock(initialSize);
+}
+
+void ScatterArena::addBlock(size_t size)
+{
+	// new[] aligns to __STDCPP_DEFAULT_NEW_ALIGNMENT__, enough for every alignment allocate accepts
+	blocks.push_back(Block{ std::unique_ptr<uint8_t[]>(new uint8_t[size]), size });
+	offset = 0;
+	stats.capacity += size;
+	stats.blockAllocations++;
+}
+
+void* ScatterArena::allocate(size_t size, size_t alignment)
+{
+	if (!alignment)
+		alignment = 1;
+
+	size_t start = (offset + alignment - 1) / alignment * alignment;
+	if (blocks.empty() || start + size > blocks.back().size)
+	{
+		// grow geometrically so a frame needs only a handful of blocks before the reset merges them
+		addBlock(std::max({ size, MIN_BLOCK_SIZE, stats.capacity }));
+		start = 0;
+	}
+
+	uint8_t* memory = blocks.back().data.get() + start;
+	stats.used += start - offset + size;
+	offset = start + size;
+
+	memset(memory, 0, size);
+	return memory;
+}
+
+ScatterArena::Stats ScatterArena::getStats() const
+{
+	// the current frame counts as well
+	Stats current = stats;
+	current.highWater = std::max(current.highWater, current.used);
+	return current;
+}
+
+void ScatterArena::reset()
+{
+	stats.highWater = std::max(stats.highWater, stats.used);
+	stats.used = 0;
+
+	if (blocks.size() > 1)
+	{
+		const size_t total = stats.capacity;
+		blocks.clear();
+		stats.capacity = 0;
+		addBlock(total);
+	}
+	offset = 0;
+}
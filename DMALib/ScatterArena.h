@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * \brief Bump allocator for the destination buffers of scatter reads.
+ * Allocations are never freed one by one, the whole arena is reset once per frame instead.
+ * Memory handed out stays at its address until the reset, so it can be given to the backend right away.
+ * When a block runs full a new one is chained, on reset they are replaced by a single block of the
+ * combined size, so from the second frame on everything lives in one contiguous block.
+ */
+class ScatterArena
+{
+public:
+	struct Stats
+	{
+		// bytes handed out since the last reset, alignment padding included
+		size_t used = 0;
+		// bytes of all blocks
+		size_t capacity = 0;
+		// most bytes used in a single frame
+		size_t highWater = 0;
+		// blocks allocated from the heap over the lifetime of the arena
+		size_t blockAllocations = 0;
+	};
+
+private:
+	struct Block
+	{
+		std::unique_ptr<uint8_t[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	// fill level of the last block
+	size_t offset = 0;
+	Stats stats{};
+
+	void addBlock(size_t size);
+
+public:
+	/**
+	 * \param initialSize size of the first block, 0 allocates on first use
+	 */
+	explicit ScatterArena(size_t initialSize = 0);
+
+	ScatterArena(ScatterArena&&) noexcept = default;
+	ScatterArena& operator=(ScatterArena&&) noexcept = default;
+
+	ScatterArena(const ScatterArena&) = delete;
+	ScatterArena& operator=(const ScatterArena&) = delete;
+
+	// Zeroed memory, valid until the next reset
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template <typename T>
+	T* allocate(size_t count = 1)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// Invalidates everything handed out, keeps the memory for the next frame
+	void reset();
+
+	Stats getStats() const;
+};
@@ -0,0 +1,53 @@
+#include "ScatterBatch.h"
+
+ScatterBatch::ScatterBatch(const DMAHandler& DMA, size_t reserve)
+	: DMA(&DMA), handle(DMA.acquireScatterHandle()), ownArena(std::make_unique<ScatterArena>(reserve * sizeof(ULONG64))), arena(ownArena.get())
+{
+	entries.reserve(reserve);
+}
+
+ScatterBatch::ScatterBatch(const DMAHandler& DMA, ScatterArena& arena, size_t reserve)
+	: DMA(&DMA), handle(DMA.acquireScatterHandle()), arena(&arena)
+{
+	entries.reserve(reserve);
+}
+
+PBYTE ScatterBatch::reserve(const ULONG64* addresses, size_t count, size_t size, size_t alignment)
+{
+	const auto buffer = static_cast<PBYTE>(arena->allocate(count * size, alignment));
+	for (size_t i = 0; i < count; i++)
+		entries.push_back(Entry{ addresses[i], buffer + i * size, static_cast<DWORD>(size) });
+
+	executed = false;
+	return buffer;
+}
+
+bool ScatterBatch::execute()
+{
+	DMA->assertNoInit();
+
+	if (!handle)
+		return false;
+
+	executed = true;
+	if (entries.empty())
+		return true;
+
+	// the handle comes back cleared with the flags of the handler, clearing again sets the ones of the batch
+	if (policy && policy->scatterFlags != DMA->readPolicy.scatterFlags)
+		DMA->backend->scatterClear(handle, DMA->processInfo.pid, policy->scatterFlags);
+
+	for (const auto& entry : entries)
+		DMA->queueScatterReadEx(handle, entry.address, entry.buffer, entry.size);
+
+	return DMA->runScatterRead(handle);
+}
+
+void ScatterBatch::clear()
+{
+	entries.clear();
+	if (ownArena)
+		ownArena->reset();
+	generation++;
+	executed = false;
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include "DMAHandler.h"
+#include "ScatterArena.h"
+
+#include <cassert>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+/**
+ * \brief Typed reference to a value queued on a ScatterBatch, only valid for the batch that created it
+ * and until that batch is cleared.
+ */
+template <typename T>
+class ScatterSlot
+{
+	T* value = nullptr;
+	uint32_t generation = 0;
+
+	friend class ScatterBatch;
+	ScatterSlot(T* value, uint32_t generation) : value(value), generation(generation) {}
+
+public:
+	ScatterSlot() = default;
+};
+
+/**
+ * \brief Reference to a dense array of values queued with ScatterBatch::readArray, same rules as ScatterSlot.
+ */
+template <typename T>
+class ScatterArray
+{
+	T* values = nullptr;
+	size_t count = 0;
+	uint32_t generation = 0;
+
+	friend class ScatterBatch;
+	ScatterArray(T* values, size_t count, uint32_t generation) : values(values), count(count), generation(generation) {}
+
+public:
+	ScatterArray() = default;
+
+	size_t size() const { return count; }
+};
+
+/**
+ * \brief A scatter read batch that owns its handle and the memory of its results.
+ * Every value is bump allocated from a ScatterArena instead of living wherever the caller put its
+ * DMAScatter objects, so the results of thousands of reads sit next to each other. Clearing resets
+ * the arena, a batch reused every frame does not allocate once it reached its largest size.
+ *
+ *	ScatterBatch batch(DMA);
+ *	auto health = batch.read<int>(player + 0x100);
+ *	batch.execute();
+ *	printf("%d\n", batch[health]);
+ *
+ * Move only. Debug builds assert on reading a slot before execute or after clear.
+ */
+class ScatterBatch
+{
+	struct Entry
+	{
+		ULONG64 address;
+		PBYTE buffer;
+		DWORD size;
+	};
+
+	const DMAHandler* DMA;
+	ScatterHandlePool::Lease handle;
+	std::vector<Entry> entries;
+	// the arena of the batch, unused if a shared arena was passed
+	std::unique_ptr<ScatterArena> ownArena;
+	ScatterArena* arena;
+	// policy of the batch, the one of the DMAHandler if not set
+	std::optional<ReadPolicy> policy;
+	// bumped on clear, slots of an older generation are stale
+	uint32_t generation = 0;
+	bool executed = false;
+
+	// Allocates zeroed memory for count values of the given size and queues one read per address
+	PBYTE reserve(const ULONG64* addresses, size_t count, size_t size, size_t alignment);
+
+	void check(uint32_t slotGeneration) const
+	{
+		assert(slotGeneration == generation && "slot of a cleared batch");
+		assert(executed && "slot read before the batch was executed");
+		(void)slotGeneration;
+	}
+
+	template <typename T>
+	static void checkType()
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "scatter reads copy raw memory, T has to be trivially copyable");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "over aligned types are not supported");
+	}
+
+public:
+	/**
+	 * \brief borrows a scatter handle from the pool of the DMAHandler
+	 * \param DMA the handler, has to outlive the batch
+	 * \param reserve amount of reads to reserve space for
+	 */
+	explicit ScatterBatch(const DMAHandler& DMA, size_t reserve = 0);
+
+	/**
+	 * \brief same as above, but the values are allocated from a shared arena, e.g. one for all batches of a frame.
+	 * clear does not reset a shared arena, its owner resets it once all batches using it are cleared.
+	 */
+	ScatterBatch(const DMAHandler& DMA, ScatterArena& arena, size_t reserve = 0);
+
+	ScatterBatch(ScatterBatch&&) noexcept = default;
+	ScatterBatch& operator=(ScatterBatch&&) noexcept = default;
+
+	ScatterBatch(const ScatterBatch&) = delete;
+	ScatterBatch& operator=(const ScatterBatch&) = delete;
+
+	/**
+	 * \brief queues a read of a T, the value is zero until the batch is executed
+	 * \return slot to access the value with operator[] after execute
+	 */
+	template <typename T>
+	ScatterSlot<T> read(ULONG64 address)
+	{
+		checkType<T>();
+		return ScatterSlot<T>(reinterpret_cast<T*>(reserve(&address, 1, sizeof(T), alignof(T))), generation);
+	}
+
+	template <typename T>
+	ScatterSlot<T> read(void* address)
+	{
+		return read<T>(reinterpret_cast<ULONG64>(address));
+	}
+
+	/**
+	 * \brief queues a read of a T at every address, the values end up next to each other in the order of the addresses
+	 * \return array to access the values as a span after execute
+	 */
+	template <typename T>
+	ScatterArray<T> readArray(std::span<const ULONG64> addresses)
+	{
+		checkType<T>();
+		return ScatterArray<T>(reinterpret_cast<T*>(reserve(addresses.data(), addresses.size(), sizeof(T), alignof(T))), addresses.size(), generation);
+	}
+
+	/**
+	 * \brief prepares every queued read and executes them in a single scatter.
+	 * Executing again without clear reads the same addresses again, e.g. to refresh the values every frame
+	 * \return false if the execute failed
+	 */
+	bool execute();
+
+	template <typename T>
+	T& operator[](ScatterSlot<T> slot)
+	{
+		check(slot.generation);
+		return *slot.value;
+	}
+
+	template <typename T>
+	const T& operator[](ScatterSlot<T> slot) const
+	{
+		check(slot.generation);
+		return *slot.value;
+	}
+
+	template <typename T>
+	std::span<T> operator[](ScatterArray<T> array)
+	{
+		check(array.generation);
+		return { array.values, array.count };
+	}
+
+	template <typename T>
+	std::span<const T> operator[](ScatterArray<T> array) const
+	{
+		check(array.generation);
+		return { array.values, array.count };
+	}
+
+	// Reads of this batch use the scatter flags of the policy instead of the ones of the DMAHandler
+	void setPolicy(const ReadPolicy& policy) { this->policy = policy; }
+
+	// Whether the batch was executed since the last clear
+	bool isExecuted() const { return executed; }
+
+	// Amount of queued reads
+	size_t size() const { return entries.size(); }
+
+	// The arena the values are allocated from
+	ScatterArena& getArena() const { return *arena; }
+
+	// Drops all reads and invalidates their slots, resets the arena unless it is shared
+	void clear();
+};
@@ -0,0 +1,132 @@
+#include "ScatterHandlePool.h"
+#include "ShardedCounter.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+ScatterHandlePool::Lease::~Lease()
+{
+	reset();
+}
+
+ScatterHandlePool::Lease::Lease(Lease&& other) noexcept
+	: pool(std::move(other.pool)), handle(std::exchange(other.handle, nullptr))
+{
+}
+
+ScatterHandlePool::Lease& ScatterHandlePool::Lease::operator=(Lease&& other) noexcept
+{
+	if (this != &other)
+	{
+		reset();
+		pool = std::move(other.pool);
+		handle = std::exchange(other.handle, nullptr);
+	}
+	return *this;
+}
+
+void ScatterHandlePool::Lease::reset()
+{
+	if (pool && handle)
+		pool->giveBack(handle);
+
+	pool.reset();
+	handle = nullptr;
+}
+
+ScatterHandlePool::ScatterHandlePool(std::shared_ptr<DMABackend> backend, DWORD pid, size_t prewarm, size_t capacity, DWORD flags)
+	: backend(std::move(backend)), pid(pid), flags(flags), capacity(capacity), threadSlots(std::max<size_t>(16, 2 * std::thread::hardware_concurrency()))
+{
+	idle.reserve(capacity);
+	for (size_t i = 0; i < prewarm && i < capacity; i++)
+	{
+		const VMMDLL_SCATTER_HANDLE handle = this->backend->scatterInitialize(pid, flags);
+		if (!handle)
+			break;
+		idle.push_back(handle);
+	}
+}
+
+ScatterHandlePool::~ScatterHandlePool()
+{
+	for (auto& slot : threadSlots)
+	{
+		if (const VMMDLL_SCATTER_HANDLE handle = slot.handle.exchange(nullptr))
+			backend->scatterClose(handle);
+	}
+
+	for (const auto handle : idle)
+		backend->scatterClose(handle);
+}
+
+ScatterHandlePool::ThreadSlot& ScatterHandlePool::slotOfThread()
+{
+	return threadSlots[threadSlot() % threadSlots.size()];
+}
+
+ScatterHandlePool::Lease ScatterHandlePool::acquire()
+{
+	if (const VMMDLL_SCATTER_HANDLE handle = slotOfThread().handle.exchange(nullptr, std::memory_order_acquire))
+	{
+		hits.fetch_add(1, std::memory_order_relaxed);
+		return Lease(shared_from_this(), handle);
+	}
+
+	{
+		std::lock_guard lock(mutex);
+		if (!idle.empty())
+		{
+			const VMMDLL_SCATTER_HANDLE handle = idle.back();
+			idle.pop_back();
+			hits.fetch_add(1, std::memory_order_relaxed);
+			return Lease(shared_from_this(), handle);
+		}
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+	return Lease(shared_from_this(), backend->scatterInitialize(pid, flags));
+}
+
+void ScatterHandlePool::giveBack(VMMDLL_SCATTER_HANDLE handle)
+{
+	// drops whatever was prepared but never executed, the next lease starts empty
+	if (backend->scatterClear(handle, pid, flags))
+	{
+		VMMDLL_SCATTER_HANDLE empty = nullptr;
+		if (slotOfThread().handle.compare_exchange_strong(empty, handle, std::memory_order_release))
+			return;
+
+		std::lock_guard lock(mutex);
+		if (idle.size() < capacity)
+		{
+			idle.push_back(handle);
+			return;
+		}
+		discarded.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	backend->scatterClose(handle);
+}
+
+ScatterHandlePool::Stats ScatterHandlePool::getStats() const
+{
+	Stats stats{};
+	stats.hits = hits.load(std::memory_order_relaxed);
+	stats.misses = misses.load(std::memory_order_relaxed);
+	stats.discarded = discarded.load(std::memory_order_relaxed);
+
+	for (const auto& slot : threadSlots)
+		stats.idle += slot.handle.load(std::memory_order_relaxed) != nullptr;
+
+	std::lock_guard lock(mutex);
+	stats.idle += idle.size();
+	return stats;
+}
+
+void ScatterHandlePool::resetStats()
+{
+	hits = 0;
+	misses = 0;
+	discarded = 0;
+}
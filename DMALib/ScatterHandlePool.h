@@ -0,0 +1,116 @@
+#pragma once
+#include "DMABackend.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Keeps initialized scatter handles of one process around so batches do not pay for
+ * VMMDLL_Scatter_Initialize and VMMDLL_Scatter_CloseHandle every frame.
+ * A handle is borrowed through a Lease and handed back, cleared, once the lease goes out of scope.
+ * Always owned by a std::shared_ptr, every lease shares the ownership, so a pool that is replaced while
+ * leases are out lives on until the last one is returned.
+ * Thread safe, leases can be taken and returned from any thread. Every thread has a slot holding the
+ * handle it returned last, taking it back needs no lock, so workers reading in parallel do not meet on the mutex.
+ * There are twice as many slots as cores (at least 16), threads beyond that share slots and fall back
+ * to the shared idle handles whenever the slot is taken.
+ */
+class ScatterHandlePool : public std::enable_shared_from_this<ScatterHandlePool>
+{
+public:
+	struct Stats
+	{
+		// leases served with a pooled handle
+		ULONG64 hits = 0;
+		// leases that had to create a new handle
+		ULONG64 misses = 0;
+		// handles closed on return because the pool was full
+		ULONG64 discarded = 0;
+		// handles waiting in the pool right now
+		ULONG64 idle = 0;
+	};
+
+	/**
+	 * \brief Borrowed scatter handle, converts to VMMDLL_SCATTER_HANDLE so it works with every DMAHandler scatter call.
+	 * Move only. Keeps its pool alive and must not be returned while an async execute on it is running.
+	 */
+	class Lease
+	{
+		std::shared_ptr<ScatterHandlePool> pool;
+		VMMDLL_SCATTER_HANDLE handle = nullptr;
+
+		friend class ScatterHandlePool;
+		Lease(std::shared_ptr<ScatterHandlePool> pool, VMMDLL_SCATTER_HANDLE handle) : pool(std::move(pool)), handle(handle) {}
+
+	public:
+		Lease() = default;
+		~Lease();
+
+		Lease(Lease&& other) noexcept;
+		Lease& operator=(Lease&& other) noexcept;
+
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		VMMDLL_SCATTER_HANDLE get() const { return handle; }
+		operator VMMDLL_SCATTER_HANDLE() const { return handle; }
+		explicit operator bool() const { return handle != nullptr; }
+
+		// Hands the handle back to the pool right away
+		void reset();
+	};
+
+private:
+	struct alignas(64) ThreadSlot
+	{
+		std::atomic<VMMDLL_SCATTER_HANDLE> handle = nullptr;
+	};
+
+	std::shared_ptr<DMABackend> backend;
+	DWORD pid;
+	DWORD flags;
+	size_t capacity;
+	// slots of the threads, indexed with threadSlot modulo their count
+	std::vector<ThreadSlot> threadSlots;
+	// handles shared by all threads, used once the slot of a thread is empty or taken
+	std::vector<VMMDLL_SCATTER_HANDLE> idle;
+	// guards idle, never held during a backend call
+	mutable std::mutex mutex;
+
+	std::atomic<ULONG64> hits = 0;
+	std::atomic<ULONG64> misses = 0;
+	std::atomic<ULONG64> discarded = 0;
+
+	void giveBack(VMMDLL_SCATTER_HANDLE handle);
+
+	ThreadSlot& slotOfThread();
+
+public:
+	/**
+	 * \brief creates the pool, use std::make_shared, acquire hands out shared ownership
+	 * \param backend backend the handles are created on
+	 * \param pid process the handles read from
+	 * \param prewarm handles created right away, so even the first frames do not initialize any
+	 * \param capacity most handles kept idle besides the ones in the thread slots, the ones returned beyond that are closed
+	 * \param flags VMMDLL_FLAG_* the handles are created and cleared with
+	 */
+	ScatterHandlePool(std::shared_ptr<DMABackend> backend, DWORD pid, size_t prewarm = 2, size_t capacity = 16, DWORD flags = VMMDLL_FLAG_NOCACHE);
+
+	// Closes the idle handles, runs once the owner and every lease let go of the pool
+	~ScatterHandlePool();
+
+	ScatterHandlePool(const ScatterHandlePool&) = delete;
+	ScatterHandlePool& operator=(const ScatterHandlePool&) = delete;
+
+	// Takes an idle handle or creates one if there is none, the lease is empty if creating failed
+	Lease acquire();
+
+	DWORD getPID() const { return pid; }
+
+	Stats getStats() const;
+
+	void resetStats();
+};
@@ -0,0 +1,110 @@
+#include "ScatterPipeline.h"
+
+#include <algorithm>
+
+ScatterPipeline::ScatterPipeline(DMAHandler* DMA)
+	: DMA(DMA)
+{
+}
+
+size_t ScatterPipeline::add(ULONG64 base, std::vector<ULONG64> offsets, void* target, size_t size)
+{
+	chains.push_back(Chain{ base, std::move(offsets), target, size });
+	return chains.size() - 1;
+}
+
+size_t ScatterPipeline::execute()
+{
+	// dereferences needed by the deepest chain, plus one round for the values at the end
+	size_t levels = 0;
+	bool values = false;
+	for (auto& chain : chains)
+	{
+		chain.address = chain.base;
+		chain.failed = false;
+		if (!chain.offsets.empty())
+			levels = std::max(levels, chain.offsets.size() - 1);
+		values |= chain.target && chain.size;
+	}
+
+	if (!levels && !values)
+	{
+		for (auto& chain : chains)
+			chain.address += chain.offsets.empty() ? 0 : chain.offsets.back();
+		return 0;
+	}
+
+	const auto handle = DMA->acquireScatterHandle();
+	if (!handle)
+		return 0;
+
+	size_t rounds = 0;
+	for (size_t level = 0; level < levels; level++)
+	{
+		bool queued = false;
+		for (auto& chain : chains)
+		{
+			if (chain.failed || level + 1 >= chain.offsets.size())
+				continue;
+
+			chain.next = 0;
+			DMA->queueScatterReadEx(handle, chain.address + chain.offsets[level], &chain.next, sizeof(chain.next));
+			queued = true;
+		}
+
+		if (!queued)
+			break;
+
+		DMA->executeScatterRead(handle);
+		rounds++;
+
+		for (auto& chain : chains)
+		{
+			if (chain.failed || level + 1 >= chain.offsets.size())
+				continue;
+
+			chain.address = chain.next;
+			chain.failed = !chain.address;
+		}
+	}
+
+	// the last offset is not dereferenced, it only points at the value
+	bool queued = false;
+	for (auto& chain : chains)
+	{
+		if (chain.failed)
+			continue;
+
+		if (!chain.offsets.empty())
+			chain.address += chain.offsets.back();
+
+		if (chain.target && chain.size)
+		{
+			DMA->queueScatterReadEx(handle, chain.address, chain.target, chain.size);
+			queued = true;
+		}
+	}
+
+	if (queued)
+	{
+		DMA->executeScatterRead(handle);
+		rounds++;
+	}
+
+	return rounds;
+}
+
+ULONG64 ScatterPipeline::address(size_t chain) const
+{
+	return chains[chain].failed ? 0 : chains[chain].address;
+}
+
+bool ScatterPipeline::resolved(size_t chain) const
+{
+	return !chains[chain].failed;
+}
+
+void ScatterPipeline::clear()
+{
+	chains.clear();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "DMAHandler.h"
+
+#include <vector>
+
+/**
+ * \brief Walks many pointer chains like base -> +0x10 -> +0x28 -> +0x8 at once.
+ * A scatter batch can not use a pointer read in the same batch, so the chains are resolved level by level:
+ * every level is one scatter round over all chains that are still alive. Resolving N chains of depth D
+ * therefore costs D round trips instead of D * N blocking reads.
+ *
+ * Every offset but the last one is added and dereferenced, the last one is added to the final pointer,
+ * the same way Cheat Engine pointer paths work. A chain that runs into a null pointer stops there and leaves its target untouched.
+ */
+class ScatterPipeline
+{
+	struct Chain
+	{
+		ULONG64 base;
+		std::vector<ULONG64> offsets;
+		// where the value at the end of the chain goes, nullptr to only resolve the address
+		void* target;
+		size_t size;
+
+		// pointer of the current level, the final address once resolved
+		ULONG64 address = 0;
+		// read target of the current round
+		ULONG64 next = 0;
+		bool failed = false;
+	};
+
+	DMAHandler* DMA;
+	std::vector<Chain> chains;
+
+public:
+	explicit ScatterPipeline(DMAHandler* DMA);
+
+	/**
+	 * \brief adds a chain
+	 * \param base address the first offset is added to
+	 * \param offsets offsets of the chain, all but the last one are dereferenced
+	 * \param target buffer for the value at the end of the chain, nullptr to only resolve the address
+	 * \param size size of the value
+	 * \return index of the chain
+	 */
+	size_t add(ULONG64 base, std::vector<ULONG64> offsets, void* target = nullptr, size_t size = 0);
+
+	template <typename T>
+	size_t add(ULONG64 base, std::vector<ULONG64> offsets, T* target)
+	{
+		return add(base, std::move(offsets), target, sizeof(T));
+	}
+
+	/**
+	 * \brief resolves all chains, one scatter round per level
+	 * \return the amount of scatter rounds, the depth of the deepest chain
+	 */
+	size_t execute();
+
+	// Final address of the chain, 0 if it ran into a null pointer
+	ULONG64 address(size_t chain) const;
+
+	// Whether the chain reached its end
+	bool resolved(size_t chain) const;
+
+	size_t count() const { return chains.size(); }
+
+	// Removes all chains
+	void clear();
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Small dense index of the calling thread, assigned on its first call.
+ * Per-thread state kept in a fixed array is indexed with it modulo the array size, so threads
+ * only share an entry once there are more threads than entries.
+ */
+inline size_t threadSlot()
+{
+	static std::atomic<size_t> next = 0;
+	thread_local const size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+	return slot;
+}
+
+/**
+ * \brief Counter that many threads add to without contending on one cache line.
+ * Every thread adds to its own slot, reading merges all of them. Lock free.
+ */
+template <size_t Slots = 64>
+class ShardedCounter
+{
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> value = 0;
+	};
+
+	std::array<Slot, Slots> slots{};
+
+public:
+	void add(uint64_t amount)
+	{
+		slots[threadSlot() % Slots].value.fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	uint64_t load() const
+	{
+		uint64_t total = 0;
+		for (const auto& slot : slots)
+			total += slot.value.load(std::memory_order_relaxed);
+		return total;
+	}
+
+	// Returns the total and starts over, an add racing with it counts toward either the old or the new total
+	uint64_t reset()
+	{
+		uint64_t total = 0;
+		for (auto& slot : slots)
+			total += slot.value.exchange(0, std::memory_order_relaxed);
+		return total;
+	}
+};
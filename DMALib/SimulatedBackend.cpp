@@ -0,0 +1,363 @@
+#include "SimulatedBackend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <cstring>
+#include <thread>
+
+SimulatedBackend::SimulatedBackend(std::shared_ptr<DMABackend> inner, const SimulatedLinkConfig& config)
+	: inner(std::move(inner)), config(config), rng(config.seed)
+{
+	if (!this->config.maxInFlight)
+		this->config.maxInFlight = 1;
+	if (!this->config.pageSize)
+		this->config.pageSize = 0x1000;
+}
+
+SimulatedBackend::Stats SimulatedBackend::getStats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
+
+void SimulatedBackend::resetStats()
+{
+	std::lock_guard lock(mutex);
+	stats = {};
+}
+
+ULONG64 SimulatedBackend::pageCount(ULONG64 address, DWORD size) const
+{
+	if (!size)
+		return 0;
+
+	const ULONG64 first = address / config.pageSize;
+	const ULONG64 last = (address + size - 1) / config.pageSize;
+	return last - first + 1;
+}
+
+void SimulatedBackend::transfer(ULONG64 pages, ULONG64 bytes, ULONG64 entries)
+{
+	const ULONG64 waves = (pages + config.maxInFlight - 1) / config.maxInFlight;
+	ULONG64 linkNs = config.requestOverheadNs + waves * config.tlpLatencyNs;
+	if (config.bytesPerSecond)
+		linkNs += bytes * 1000000000ull / config.bytesPerSecond;
+	const ULONG64 hostNs = entries * config.scatterEntryNs;
+
+	ULONG64 queuedNs = 0;
+	{
+		std::lock_guard lock(mutex);
+		if (config.realTime)
+		{
+			// wait until the requests queued before are done, then hold the link for this one
+			const auto now = std::chrono::steady_clock::now();
+			const auto start = std::max(now, linkBusyUntil);
+			queuedNs = static_cast<ULONG64>(std::chrono::duration_cast<std::chrono::nanoseconds>(start - now).count());
+			linkBusyUntil = start + std::chrono::nanoseconds(linkNs);
+		}
+
+		stats.simulatedNs += linkNs + hostNs;
+		stats.queuedNs += queuedNs;
+		stats.requests++;
+		stats.pages += pages;
+		stats.bytesTransferred += bytes;
+	}
+
+	spend(queuedNs + linkNs + hostNs);
+}
+
+void SimulatedBackend::lookup()
+{
+	{
+		std::lock_guard lock(mutex);
+		stats.simulatedNs += config.lookupNs;
+	}
+	spend(config.lookupNs);
+	transfer(0, 0);
+}
+
+void SimulatedBackend::spend(ULONG64 ns) const
+{
+	if (!config.realTime)
+		return;
+
+	// sleep for the coarse part, spin for the rest, sleep alone is far too inaccurate for microseconds
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+	if (ns > 2000000)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(ns - 1000000));
+
+	while (std::chrono::steady_clock::now() < deadline)
+		std::this_thread::yield();
+}
+
+DWORD SimulatedBackend::injectFailures(ULONG64 address, PBYTE buffer, DWORD size)
+{
+	if (config.failureRate <= 0.0 || !size)
+		return 0;
+
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	const ULONG64 end = address + size;
+	DWORD lost = 0;
+
+	for (ULONG64 page = address - address % config.pageSize; page < end; page += config.pageSize)
+	{
+		if (chance(rng) >= config.failureRate)
+			continue;
+
+		const ULONG64 from = std::max(address, page);
+		const ULONG64 to = std::min(end, page + config.pageSize);
+		memset(buffer + (from - address), 0, to - from);
+		lost += static_cast<DWORD>(to - from);
+		stats.failedPages++;
+	}
+	return lost;
+}
+
+bool SimulatedBackend::isInitialized() const
+{
+	return inner && inner->isInitialized();
+}
+
+void SimulatedBackend::close()
+{
+	if (inner)
+		inner->close();
+}
+
+ULONG64 SimulatedBackend::getTargetFingerprint()
+{
+	return inner->getTargetFingerprint();
+}
+
+bool SimulatedBackend::getPidFromName(const char* processName, DWORD* pid)
+{
+	lookup();
+	return inner->getPidFromName(processName, pid);
+}
+
+ULONG64 SimulatedBackend::getModuleBase(DWORD pid, const char* moduleName)
+{
+	lookup();
+	return inner->getModuleBase(pid, moduleName);
+}
+
+ULONG64 SimulatedBackend::fetchPages(DWORD pid, const std::vector<ULONG64>& pages, ULONG64 flags)
+{
+	if (!config.dataCacheLifetimeNs)
+		return pages.size();
+
+	std::lock_guard lock(mutex);
+	ULONG64 fetch = 0;
+	for (const ULONG64 page : pages)
+	{
+		const ULONG64 key = static_cast<ULONG64>(pid) << 48 ^ page;
+		const auto it = dataCache.find(key);
+		if (!(flags & VMMDLL_FLAG_NOCACHE) && it != dataCache.end() && stats.simulatedNs - it->second < config.dataCacheLifetimeNs)
+		{
+			stats.cachedPages++;
+			continue;
+		}
+
+		fetch++;
+		// MemProcFS puts every page it fetched into the cache, NOCACHE only skips the lookup
+		if (!(flags & VMMDLL_FLAG_NOCACHEPUT))
+			dataCache[key] = stats.simulatedNs;
+	}
+	return fetch;
+}
+
+void SimulatedBackend::transferPages(DWORD pid, const std::vector<ULONG64>& pages, ULONG64 flags, ULONG64 entries)
+{
+	const ULONG64 fetch = fetchPages(pid, pages, flags);
+	if (fetch || pages.empty())
+	{
+		transfer(fetch, fetch * config.pageSize, entries);
+		return;
+	}
+
+	{
+		std::lock_guard lock(mutex);
+		stats.simulatedNs += config.dataCacheHitNs;
+	}
+	spend(config.dataCacheHitNs);
+}
+
+bool SimulatedBackend::read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags)
+{
+	std::vector<ULONG64> pages(pageCount(address, size));
+	std::iota(pages.begin(), pages.end(), address / config.pageSize);
+	transferPages(pid, pages, flags);
+
+	DWORD read = 0;
+	const bool result = inner->read(pid, address, buffer, size, &read, flags);
+	if (result)
+	{
+		std::lock_guard lock(mutex);
+		read -= std::min(read, injectFailures(address, buffer, size));
+	}
+
+	if (bytesRead)
+		*bytesRead = read;
+
+	return result && (read || !size);
+}
+
+bool SimulatedBackend::write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	// writes are posted, no round trip to wait for
+	transfer(0, size);
+	return inner->write(pid, address, buffer, size);
+}
+
+bool SimulatedBackend::prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count)
+{
+	std::vector<ULONG64> pages(count);
+	for (DWORD i = 0; i < count; i++)
+		pages[i] = addresses[i] / config.pageSize;
+	std::sort(pages.begin(), pages.end());
+	pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+	// fetches whatever is not cached yet and puts it into the data cache
+	const ULONG64 fetch = fetchPages(pid, pages, 0);
+	if (fetch)
+		transfer(fetch, fetch * config.pageSize);
+
+	return inner->prefetchPages(pid, addresses, count);
+}
+
+VMMDLL_SCATTER_HANDLE SimulatedBackend::scatterInitialize(DWORD pid, DWORD flags)
+{
+	const VMMDLL_SCATTER_HANDLE handle = inner->scatterInitialize(pid, flags);
+	if (!handle)
+		return nullptr;
+
+	{
+		std::lock_guard lock(mutex);
+		scatters[handle] = ScatterInfo{ {}, 0, pid, flags };
+		stats.simulatedNs += config.scatterSetupNs;
+		stats.handlesCreated++;
+	}
+	spend(config.scatterSetupNs);
+	return handle;
+}
+
+bool SimulatedBackend::scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	if (!inner->scatterPrepare(handle, address, size, buffer, bytesRead))
+		return false;
+
+	std::lock_guard lock(mutex);
+	scatters[handle].reads.push_back(ScatterEntry{ address, size, buffer, bytesRead });
+	return true;
+}
+
+bool SimulatedBackend::scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	if (!inner->scatterPrepareWrite(handle, address, buffer, size))
+		return false;
+
+	std::lock_guard lock(mutex);
+	scatters[handle].writeBytes += size;
+	return true;
+}
+
+std::vector<ULONG64> SimulatedBackend::distinctPages(const std::vector<ScatterEntry>& entries) const
+{
+	// the device fetches every distinct page once, no matter how many entries touch it
+	std::vector<ULONG64> pages;
+	for (const auto& entry : entries)
+	{
+		if (!entry.size)
+			continue;
+		for (ULONG64 page = entry.address / config.pageSize; page <= (entry.address + entry.size - 1) / config.pageSize; page++)
+			pages.push_back(page);
+	}
+	std::sort(pages.begin(), pages.end());
+	pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+	return pages;
+}
+
+void SimulatedBackend::injectScatterFailures(const std::vector<ScatterEntry>& entries)
+{
+	std::lock_guard lock(mutex);
+	for (const auto& entry : entries)
+	{
+		if (!entry.buffer)
+			continue;
+
+		const DWORD lost = injectFailures(entry.address, entry.buffer, entry.size);
+		if (entry.bytesRead)
+			*entry.bytesRead -= std::min(*entry.bytesRead, lost);
+	}
+}
+
+bool SimulatedBackend::copyScatter(VMMDLL_SCATTER_HANDLE handle, ScatterInfo& info)
+{
+	std::lock_guard lock(mutex);
+	const auto it = scatters.find(handle);
+	if (it == scatters.end())
+		return false;
+
+	info = it->second;
+	return true;
+}
+
+bool SimulatedBackend::scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle)
+{
+	ScatterInfo info;
+	if (!copyScatter(handle, info))
+		return inner->scatterExecuteRead(handle);
+
+	transferPages(info.pid, distinctPages(info.reads), info.flags, info.reads.size());
+
+	if (!inner->scatterExecuteRead(handle))
+		return false;
+
+	injectScatterFailures(info.reads);
+	return true;
+}
+
+bool SimulatedBackend::scatterExecute(VMMDLL_SCATTER_HANDLE handle)
+{
+	ScatterInfo info;
+	if (!copyScatter(handle, info))
+		return inner->scatterExecute(handle);
+
+	if (info.writeBytes)
+		transfer(0, info.writeBytes);
+
+	if (!info.reads.empty())
+		transferPages(info.pid, distinctPages(info.reads), info.flags, info.reads.size());
+
+	if (!inner->scatterExecute(handle))
+		return false;
+
+	injectScatterFailures(info.reads);
+	return true;
+}
+
+bool SimulatedBackend::scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	return inner->scatterRead(handle, address, size, buffer, bytesRead);
+}
+
+bool SimulatedBackend::scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags)
+{
+	{
+		std::lock_guard lock(mutex);
+		const auto it = scatters.find(handle);
+		if (it != scatters.end())
+			it->second = ScatterInfo{ {}, 0, pid ? pid : it->second.pid, flags };
+	}
+	return inner->scatterClear(handle, pid, flags);
+}
+
+void SimulatedBackend::scatterClose(VMMDLL_SCATTER_HANDLE handle)
+{
+	{
+		std::lock_guard lock(mutex);
+		scatters.erase(handle);
+	}
+	inner->scatterClose(handle);
+}
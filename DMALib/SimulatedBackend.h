@@ -0,0 +1,159 @@
+#pragma once
+#include "DMABackend.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief Cost model of the PCIe/USB link between the host and the FPGA.
+ * Defaults are in the ballpark of a 75T board over USB3.
+ */
+struct SimulatedLinkConfig
+{
+	// fixed cost of every request (USB round trip, driver overhead)
+	ULONG64 requestOverheadNs = 30000;
+	// round trip of one read TLP, one TLP is issued per page touched
+	ULONG64 tlpLatencyNs = 2000;
+	// host side cost of every scatter entry (MEM_SCATTER setup and copy back), paid even if entries share a page
+	ULONG64 scatterEntryNs = 500;
+	// host side cost of creating a scatter handle, VMMDLL allocates and sets up its internal state
+	ULONG64 scatterSetupNs = 10000;
+	// host side cost of resolving a pid or a module base, MemProcFS walks the process list or the loader data of the process
+	ULONG64 lookupNs = 1000000;
+	// how many TLPs the device keeps in flight at once, shared by all callers since the link serves one request at a time
+	DWORD maxInFlight = 32;
+	// sustained transfer rate of the link
+	ULONG64 bytesPerSecond = 180ull * 1024 * 1024;
+	// transfer granularity, reads are always fetched in whole pages
+	ULONG64 pageSize = 0x1000;
+	// how long MemProcFS keeps a page in its data cache, reads without VMMDLL_FLAG_NOCACHE are served from it meanwhile. 0 disables the cache
+	ULONG64 dataCacheLifetimeNs = 100000000;
+	// host side cost of a read served entirely from the data cache
+	ULONG64 dataCacheHitNs = 1000;
+	// probability that a single page read fails and comes back zeroed
+	double failureRate = 0.0;
+	// seed for the failure generator, same seed -> same failures
+	ULONG64 seed = 0x5EED;
+	// if false the modelled time is only accounted, not waited for
+	bool realTime = true;
+};
+
+/**
+ * \brief Backend that wraps another backend (usually a FileBackend) and adds the latency,
+ * bandwidth and failure behaviour of a real DMA link on top of it.
+ * Fully deterministic for a given config when used from one thread, so batching, caching and
+ * scheduling can be tuned and benchmarked offline.
+ * The link is one resource: requests from several threads are served one after the other, only the host side
+ * costs (scatter entries, handle setup, lookups, data cache hits) overlap. Model several devices with several backends.
+ */
+class SimulatedBackend : public DMABackend
+{
+public:
+	struct Stats
+	{
+		// modelled time spent on the link
+		ULONG64 simulatedNs = 0;
+		// time requests waited for the link while it served requests of other threads, only with realTime
+		ULONG64 queuedNs = 0;
+		ULONG64 requests = 0;
+		ULONG64 handlesCreated = 0;
+		ULONG64 pages = 0;
+		// pages served from the modelled MemProcFS data cache
+		ULONG64 cachedPages = 0;
+		ULONG64 failedPages = 0;
+		ULONG64 bytesTransferred = 0;
+	};
+
+private:
+	struct ScatterEntry
+	{
+		ULONG64 address;
+		DWORD size;
+		PBYTE buffer;
+		DWORD* bytesRead;
+	};
+
+	struct ScatterInfo
+	{
+		std::vector<ScatterEntry> reads;
+		DWORD writeBytes = 0;
+		DWORD pid = 0;
+		DWORD flags = 0;
+	};
+
+	std::shared_ptr<DMABackend> inner;
+	SimulatedLinkConfig config;
+	std::mt19937_64 rng;
+	std::unordered_map<VMMDLL_SCATTER_HANDLE, ScatterInfo> scatters;
+	// (pid, page) -> simulated time the page entered the data cache
+	std::unordered_map<ULONG64, ULONG64> dataCache;
+	Stats stats{};
+	// the link serves one request at a time like LeechCore holding the device for the whole request, so callers on other threads queue up behind it
+	std::chrono::steady_clock::time_point linkBusyUntil{};
+	// guards scatters, stats, rng and linkBusyUntil, handles may be prepared and executed on different threads
+	mutable std::mutex mutex;
+
+	// Accounts (and waits for) a request touching the given amount of distinct pages, including the wait for the link
+	void transfer(ULONG64 pages, ULONG64 bytes, ULONG64 entries = 0);
+
+	// Accounts a pid or module base lookup
+	void lookup();
+
+	// Waits for the modelled time if realTime is set
+	void spend(ULONG64 ns) const;
+
+	// Zeroes failed pages of a finished read, returns the amount of bytes lost. Expects mutex to be held
+	DWORD injectFailures(ULONG64 address, PBYTE buffer, DWORD size);
+
+	ULONG64 pageCount(ULONG64 address, DWORD size) const;
+
+	std::vector<ULONG64> distinctPages(const std::vector<ScatterEntry>& entries) const;
+
+	// Drops the pages served from the data cache and puts the rest into it, as far as the flags allow. Returns the amount of pages left to fetch
+	ULONG64 fetchPages(DWORD pid, const std::vector<ULONG64>& pages, ULONG64 flags);
+
+	// Accounts a read of the given pages, reads served entirely from the data cache only pay dataCacheHitNs
+	void transferPages(DWORD pid, const std::vector<ULONG64>& pages, ULONG64 flags, ULONG64 entries = 0);
+
+	void injectScatterFailures(const std::vector<ScatterEntry>& entries);
+
+	// Copies the bookkeeping of a handle, false if the handle was not created through this backend
+	bool copyScatter(VMMDLL_SCATTER_HANDLE handle, ScatterInfo& info);
+
+public:
+	SimulatedBackend(std::shared_ptr<DMABackend> inner, const SimulatedLinkConfig& config = {});
+
+	const SimulatedLinkConfig& getConfig() const { return config; }
+
+	Stats getStats() const;
+
+	void resetStats();
+
+	const char* name() const override { return "simulated"; }
+
+	bool isInitialized() const override;
+
+	void close() override;
+
+	ULONG64 getTargetFingerprint() override;
+
+	bool getPidFromName(const char* processName, DWORD* pid) override;
+	ULONG64 getModuleBase(DWORD pid, const char* moduleName) override;
+
+	bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) override;
+	bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) override;
+
+	VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) override;
+	bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) override;
+	void scatterClose(VMMDLL_SCATTER_HANDLE handle) override;
+};
@@ -0,0 +1,263 @@
+#include "TargetCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t MAGIC = 0x43544C44; // "DLTC"
+	// longer names are treated as a broken file
+	constexpr uint32_t MAX_NAME = 260;
+	// more entries of a kind are treated as a broken file, far above what a target ever has
+	constexpr uint32_t MAX_ENTRIES = 0x10000;
+	// smallest size of an entry on disk, a name takes at least its length
+	constexpr ULONG64 MIN_PROCESS_SIZE = sizeof(DWORD) + sizeof(uint32_t);
+	constexpr ULONG64 MIN_MODULE_SIZE = sizeof(DWORD) + sizeof(ULONG64) + sizeof(uint32_t);
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		ULONG64 fingerprint;
+		uint32_t ranges;
+		uint32_t processes;
+		uint32_t modules;
+		uint32_t reserved;
+	};
+
+	std::string lower(std::string name)
+	{
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+		return name;
+	}
+
+	template <typename T>
+	bool get(std::istream& in, T& value)
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	bool getName(std::istream& in, std::string& name)
+	{
+		uint32_t length = 0;
+		if (!get(in, length) || length > MAX_NAME)
+			return false;
+
+		name.resize(length);
+		return static_cast<bool>(in.read(name.data(), length));
+	}
+
+	template <typename T>
+	void put(std::ostream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void putName(std::ostream& out, const std::string& name)
+	{
+		put(out, static_cast<uint32_t>(name.size()));
+		out.write(name.data(), static_cast<std::streamsize>(name.size()));
+	}
+}
+
+TargetCache::TargetCache(std::string path)
+	: path(std::move(path))
+{
+}
+
+bool TargetCache::load(ULONG64 fingerprint)
+{
+	std::lock_guard lock(mutex);
+	this->fingerprint = fingerprint;
+	memoryMap.clear();
+	pids.clear();
+	moduleBases.clear();
+
+	if (!fingerprint)
+		return false;
+
+	std::ifstream in(path, std::ios::binary);
+	Header header{};
+	if (!in || !get(in, header))
+		return false;
+
+	if (header.magic != MAGIC || header.version != VERSION || header.fingerprint != fingerprint)
+		return false;
+
+	// the counts size the vectors below, a broken file must not make them allocate more than the file holds
+	const auto start = in.tellg();
+	in.seekg(0, std::ios::end);
+	const ULONG64 remaining = static_cast<ULONG64>(in.tellg() - start);
+	in.seekg(start);
+	if (header.ranges > MAX_ENTRIES || header.processes > MAX_ENTRIES || header.modules > MAX_ENTRIES)
+		return false;
+	if (header.ranges * sizeof(MemoryRange) + header.processes * MIN_PROCESS_SIZE + header.modules * MIN_MODULE_SIZE > remaining)
+		return false;
+
+	// read into locals first, a truncated file must not leave half of its entries behind
+	std::vector<MemoryRange> ranges(header.ranges);
+	for (auto& range : ranges)
+	{
+		if (!get(in, range))
+			return false;
+	}
+
+	std::map<std::string, DWORD> loadedPids;
+	for (uint32_t i = 0; i < header.processes; i++)
+	{
+		DWORD pid = 0;
+		std::string name;
+		if (!get(in, pid) || !getName(in, name))
+			return false;
+		loadedPids[name] = pid;
+	}
+
+	std::map<std::pair<DWORD, std::string>, ULONG64> loadedModules;
+	for (uint32_t i = 0; i < header.modules; i++)
+	{
+		DWORD pid = 0;
+		ULONG64 base = 0;
+		std::string name;
+		if (!get(in, pid) || !get(in, base) || !getName(in, name))
+			return false;
+		loadedModules[{ pid, name }] = base;
+	}
+
+	memoryMap = std::move(ranges);
+	pids = std::move(loadedPids);
+	moduleBases = std::move(loadedModules);
+	return !memoryMap.empty() || !pids.empty() || !moduleBases.empty();
+}
+
+bool TargetCache::write() const
+{
+	if (!fingerprint)
+		return false;
+
+	// written next to the file and moved over it, a crash mid write never leaves a broken cache behind
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+
+		const Header header{ MAGIC, VERSION, fingerprint, static_cast<uint32_t>(memoryMap.size()), static_cast<uint32_t>(pids.size()), static_cast<uint32_t>(moduleBases.size()), 0 };
+		put(out, header);
+
+		for (const auto& range : memoryMap)
+			put(out, range);
+
+		for (const auto& [name, pid] : pids)
+		{
+			put(out, pid);
+			putName(out, name);
+		}
+
+		for (const auto& [key, base] : moduleBases)
+		{
+			put(out, key.first);
+			put(out, base);
+			putName(out, key.second);
+		}
+
+		if (!out)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+bool TargetCache::save() const
+{
+	std::lock_guard lock(mutex);
+	return write();
+}
+
+ULONG64 TargetCache::getFingerprint() const
+{
+	std::lock_guard lock(mutex);
+	return fingerprint;
+}
+
+std::vector<TargetCache::MemoryRange> TargetCache::getMemoryMap() const
+{
+	std::lock_guard lock(mutex);
+	return memoryMap;
+}
+
+void TargetCache::storeMemoryMap(std::vector<MemoryRange> ranges)
+{
+	std::lock_guard lock(mutex);
+	memoryMap = std::move(ranges);
+	write();
+}
+
+bool TargetCache::findPid(const std::string& processName, DWORD* pid)
+{
+	std::lock_guard lock(mutex);
+	const auto it = pids.find(lower(processName));
+	if (it == pids.end())
+	{
+		stats.misses++;
+		return false;
+	}
+
+	stats.hits++;
+	*pid = it->second;
+	return true;
+}
+
+void TargetCache::storePid(const std::string& processName, DWORD pid)
+{
+	std::lock_guard lock(mutex);
+	pids[lower(processName)] = pid;
+	write();
+}
+
+ULONG64 TargetCache::findModuleBase(DWORD pid, const std::string& moduleName)
+{
+	std::lock_guard lock(mutex);
+	const auto it = moduleBases.find({ pid, lower(moduleName) });
+	if (it == moduleBases.end())
+	{
+		stats.misses++;
+		return 0;
+	}
+
+	stats.hits++;
+	return it->second;
+}
+
+void TargetCache::storeModuleBase(DWORD pid, const std::string& moduleName, ULONG64 base)
+{
+	std::lock_guard lock(mutex);
+	moduleBases[{ pid, lower(moduleName) }] = base;
+	write();
+}
+
+void TargetCache::rejectProcess(const std::string& processName, DWORD pid)
+{
+	std::lock_guard lock(mutex);
+	stats.rejected++;
+	pids.erase(lower(processName));
+	std::erase_if(moduleBases, [pid](const auto& entry) { return entry.first.first == pid; });
+	write();
+}
+
+void TargetCache::rejectModule(DWORD pid, const std::string& moduleName)
+{
+	std::lock_guard lock(mutex);
+	stats.rejected++;
+	moduleBases.erase({ pid, lower(moduleName) });
+	write();
+}
+
+TargetCache::Stats TargetCache::getStats() const
+{
+	std::lock_guard lock(mutex);
+	return stats;
+}
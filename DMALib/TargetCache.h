@@ -0,0 +1,95 @@
+#pragma once
+#include "DMACompat.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Metadata of a target that stays the same until it reboots: the physical memory map,
+ * the pids of processes and the bases of their modules. Kept in a small binary file so a
+ * restart of the collector skips the lookups.
+ *
+ * The file belongs to the target with a given fingerprint (see DMABackend::getTargetFingerprint),
+ * a file of another target, boot or format version is dropped on load. Entries are only hints,
+ * the users of the cache check them with a read before trusting them.
+ */
+class TargetCache
+{
+public:
+	// Bumped whenever the layout of the file changes
+	static constexpr uint32_t VERSION = 1;
+
+	struct MemoryRange
+	{
+		ULONG64 pa;
+		ULONG64 cb;
+	};
+
+	struct Stats
+	{
+		// lookups answered from the cache
+		ULONG64 hits = 0;
+		ULONG64 misses = 0;
+		// cached entries that failed their check and were dropped
+		ULONG64 rejected = 0;
+	};
+
+private:
+	std::string path;
+	ULONG64 fingerprint = 0;
+	std::vector<MemoryRange> memoryMap;
+	// lower case process name -> pid
+	std::map<std::string, DWORD> pids;
+	// (pid, lower case module name) -> base
+	std::map<std::pair<DWORD, std::string>, ULONG64> moduleBases;
+	Stats stats{};
+	// guards everything above
+	mutable std::mutex mutex;
+
+	// Writes the file. Expects mutex to be held
+	bool write() const;
+
+public:
+	/**
+	 * \param path file the cache is loaded from and saved to, created on the first save
+	 */
+	explicit TargetCache(std::string path);
+
+	/**
+	 * \brief loads the file if it was written for the target with this fingerprint, drops every entry otherwise
+	 * \param fingerprint 0 disables the cache, nothing is loaded or saved
+	 * \return whether entries were loaded
+	 */
+	bool load(ULONG64 fingerprint);
+
+	// Writes every entry to the file, false if no fingerprint is set or the file could not be written
+	bool save() const;
+
+	// Fingerprint of the loaded target, 0 before load
+	ULONG64 getFingerprint() const;
+
+	const std::string& getPath() const { return path; }
+
+	// The cached physical memory map, empty if none is cached
+	std::vector<MemoryRange> getMemoryMap() const;
+	void storeMemoryMap(std::vector<MemoryRange> ranges);
+
+	// false if the process is not cached
+	bool findPid(const std::string& processName, DWORD* pid);
+	void storePid(const std::string& processName, DWORD pid);
+
+	// 0 if the module is not cached
+	ULONG64 findModuleBase(DWORD pid, const std::string& moduleName);
+	void storeModuleBase(DWORD pid, const std::string& moduleName, ULONG64 base);
+
+	// Drops a process and its modules after a failed check
+	void rejectProcess(const std::string& processName, DWORD pid);
+
+	// Drops a module after a failed check
+	void rejectModule(DWORD pid, const std::string& moduleName);
+
+	Stats getStats() const;
+};
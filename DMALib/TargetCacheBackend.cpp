@@ -0,0 +1,130 @@
+#include "TargetCacheBackend.h"
+
+TargetCacheBackend::TargetCacheBackend(std::shared_ptr<DMABackend> inner, std::shared_ptr<TargetCache> cache)
+	: inner(std::move(inner)), cache(std::move(cache))
+{
+	if (!this->inner || !this->inner->isInitialized())
+		return;
+
+	const ULONG64 fingerprint = this->inner->getTargetFingerprint();
+	if (this->cache->getFingerprint() != fingerprint)
+		this->cache->load(fingerprint);
+}
+
+bool TargetCacheBackend::isImage(DWORD pid, ULONG64 base)
+{
+	WORD magic = 0;
+	DWORD bytesRead = 0;
+	return inner->read(pid, base, reinterpret_cast<PBYTE>(&magic), sizeof(magic), &bytesRead, VMMDLL_FLAG_NOCACHE) && bytesRead == sizeof(magic) && magic == IMAGE_DOS_SIGNATURE;
+}
+
+bool TargetCacheBackend::isInitialized() const
+{
+	return inner && inner->isInitialized();
+}
+
+void TargetCacheBackend::close()
+{
+	if (inner)
+		inner->close();
+}
+
+ULONG64 TargetCacheBackend::getTargetFingerprint()
+{
+	return inner->getTargetFingerprint();
+}
+
+bool TargetCacheBackend::getPidFromName(const char* processName, DWORD* pid)
+{
+	DWORD cached = 0;
+	if (cache->findPid(processName, &cached))
+	{
+		// the main module of the process is checked, a restarted process gets a new pid
+		const ULONG64 base = cache->findModuleBase(cached, processName);
+		if (base && isImage(cached, base))
+		{
+			*pid = cached;
+			return true;
+		}
+		cache->rejectProcess(processName, cached);
+	}
+
+	if (!inner->getPidFromName(processName, pid))
+		return false;
+
+	cache->storePid(processName, *pid);
+	// stored right away, the next launch needs it to check the pid
+	if (const ULONG64 base = inner->getModuleBase(*pid, processName))
+		cache->storeModuleBase(*pid, processName, base);
+	return true;
+}
+
+ULONG64 TargetCacheBackend::getModuleBase(DWORD pid, const char* moduleName)
+{
+	if (const ULONG64 cached = cache->findModuleBase(pid, moduleName))
+	{
+		if (isImage(pid, cached))
+			return cached;
+		cache->rejectModule(pid, moduleName);
+	}
+
+	const ULONG64 base = inner->getModuleBase(pid, moduleName);
+	if (base)
+		cache->storeModuleBase(pid, moduleName, base);
+	return base;
+}
+
+bool TargetCacheBackend::read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags)
+{
+	return inner->read(pid, address, buffer, size, bytesRead, flags);
+}
+
+bool TargetCacheBackend::write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	return inner->write(pid, address, buffer, size);
+}
+
+bool TargetCacheBackend::prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count)
+{
+	return inner->prefetchPages(pid, addresses, count);
+}
+
+VMMDLL_SCATTER_HANDLE TargetCacheBackend::scatterInitialize(DWORD pid, DWORD flags)
+{
+	return inner->scatterInitialize(pid, flags);
+}
+
+bool TargetCacheBackend::scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	return inner->scatterPrepare(handle, address, size, buffer, bytesRead);
+}
+
+bool TargetCacheBackend::scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	return inner->scatterPrepareWrite(handle, address, buffer, size);
+}
+
+bool TargetCacheBackend::scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle)
+{
+	return inner->scatterExecuteRead(handle);
+}
+
+bool TargetCacheBackend::scatterExecute(VMMDLL_SCATTER_HANDLE handle)
+{
+	return inner->scatterExecute(handle);
+}
+
+bool TargetCacheBackend::scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	return inner->scatterRead(handle, address, size, buffer, bytesRead);
+}
+
+bool TargetCacheBackend::scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags)
+{
+	return inner->scatterClear(handle, pid, flags);
+}
+
+void TargetCacheBackend::scatterClose(VMMDLL_SCATTER_HANDLE handle)
+{
+	inner->scatterClose(handle);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "DMABackend.h"
+#include "TargetCache.h"
+
+#include <memory>
+
+/**
+ * \brief Backend that wraps another backend and answers pid and module base lookups from a TargetCache,
+ * so a warm restart does not walk the process list and the loader data of the target again.
+ * A cached entry is checked with a read of the DOS header at the module base before it is returned,
+ * entries failing the check (e.g. the process restarted) are dropped and looked up again.
+ * Everything else passes through untouched.
+ */
+class TargetCacheBackend : public DMABackend
+{
+	std::shared_ptr<DMABackend> inner;
+	std::shared_ptr<TargetCache> cache;
+
+	// Whether a PE image starts at base, the check of every cached entry
+	bool isImage(DWORD pid, ULONG64 base);
+
+public:
+	/**
+	 * \brief loads the cache for the target of the wrapped backend unless it already is
+	 */
+	TargetCacheBackend(std::shared_ptr<DMABackend> inner, std::shared_ptr<TargetCache> cache);
+
+	const std::shared_ptr<TargetCache>& getCache() const { return cache; }
+
+	const char* name() const override { return "targetcache"; }
+
+	bool isInitialized() const override;
+
+	void close() override;
+
+	ULONG64 getTargetFingerprint() override;
+
+	bool getPidFromName(const char* processName, DWORD* pid) override;
+	ULONG64 getModuleBase(DWORD pid, const char* moduleName) override;
+
+	bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) override;
+	bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) override;
+
+	VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) override;
+	bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) override;
+	void scatterClose(VMMDLL_SCATTER_HANDLE handle) override;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * \brief Fixed amount of worker threads executing queued jobs in FIFO order.
+ * Used for CPU bound work like sharded pattern scans and, with a single worker, as I/O thread.
+ * Never block a worker on another job of the same pool.
+ */
+class ThreadPool
+{
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void workerLoop();
+
+	void enqueue(std::function<void()> job);
+
+public:
+	/**
+	 * \brief starts the workers
+	 * \param threads amount of workers, 0 uses one per hardware thread
+	 */
+	explicit ThreadPool(size_t threads = 0);
+
+	// Finishes the queued jobs and joins the workers
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const { return workers.size(); }
+
+	// Queues a job, the future holds its result or rethrows whatever it threw
+	template <typename Fn>
+	auto submit(Fn job) -> std::future<std::invoke_result_t<Fn>>
+	{
+		// std::function needs a copyable target, packaged_task is move only
+		auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Fn>()>>(std::move(job));
+		auto future = task->get_future();
+		enqueue([task] { (*task)(); });
+		return future;
+	}
+
+	// Pool shared by all DMALib classes, created on first use
+	static ThreadPool& shared();
+};
@@ -0,0 +1,269 @@
+// ReSharper disable CppCStyleCast
+#include "VMMBackend.h"
+#include "DMAHandler.h"
+
+#include <chrono>
+#include <vector>
+#include <leechcore.h>
+
+#ifdef _WIN32
+constexpr auto VMM_LIBRARY = "vmm.dll";
+constexpr auto FTD3XX_LIBRARY = "FTD3XX.dll";
+constexpr auto LEECHCORE_LIBRARY = "leechcore.dll";
+#else
+constexpr auto VMM_LIBRARY = "vmm.so";
+constexpr auto FTD3XX_LIBRARY = "libftd3xx.so";
+constexpr auto LEECHCORE_LIBRARY = "leechcore.so";
+#endif
+
+VMMBackend::VMMBackend(bool memMap, std::shared_ptr<TargetCache> cache, const std::string& device)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto since = [](Clock::time_point start)
+	{
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+	};
+	const auto startup = Clock::now();
+
+	DMAHandler::log("loading libraries...");
+	auto phase = Clock::now();
+	modules.VMM = LoadLibraryA(VMM_LIBRARY);
+	modules.FTD3XX = LoadLibraryA(FTD3XX_LIBRARY);
+	modules.LEECHCORE = LoadLibraryA(LEECHCORE_LIBRARY);
+	const long long librariesMs = since(phase);
+
+	if (!modules.VMM || !modules.FTD3XX || !modules.LEECHCORE)
+	{
+		DMAHandler::log("ERROR: could not load a library:");
+		DMAHandler::log("vmm: %p\n", modules.VMM);
+		DMAHandler::log("ftd: %p\n", modules.FTD3XX);
+		DMAHandler::log("leech: %p\n", modules.LEECHCORE);
+	}
+
+	DMAHandler::log("inizializing %s...", device.c_str());
+
+	LPSTR args[] = { (LPSTR)"", (LPSTR)"-device", (LPSTR)device.c_str(), (LPSTR)"-v" };
+	phase = Clock::now();
+	vmmHandle = VMMDLL_Initialize(4, args);
+	const long long initializeMs = since(phase);
+	if (!vmmHandle)
+	{
+		DMAHandler::log("ERROR: Initialization failed! Is the DMA in use or disconnected?");
+		return;
+	}
+
+	long long cacheMs = 0;
+	if (cache)
+	{
+		phase = Clock::now();
+		if (cache->load(getTargetFingerprint()))
+			DMAHandler::log("loaded target cache %s", cache->getPath().c_str());
+		cacheMs = since(phase);
+	}
+
+	long long memMapMs = 0;
+	if (memMap)
+	{
+		DMAHandler::log("applying memory map...");
+		phase = Clock::now();
+		if (!applyMemoryMap(cache))
+		{
+			DMAHandler::log("ERROR: Could not apply memory map!");
+			DMAHandler::log("Defaulting to no memory map!");
+		}
+		memMapMs = since(phase);
+	}
+
+	ULONG64 FPGA_ID = 0, DEVICE_ID = 0;
+
+	VMMDLL_ConfigGet(vmmHandle, LC_OPT_FPGA_FPGA_ID, &FPGA_ID);
+	VMMDLL_ConfigGet(vmmHandle, LC_OPT_FPGA_DEVICE_ID, &DEVICE_ID);
+
+	DMAHandler::log("FPGA ID: %llu", FPGA_ID);
+	DMAHandler::log("DEVICE ID: %llu", DEVICE_ID);
+	DMAHandler::log("startup: libraries %lld ms, initialize %lld ms, target cache %lld ms, memory map %lld ms, total %lld ms", librariesMs, initializeMs, cacheMs, memMapMs, since(startup));
+	DMAHandler::log("success!");
+}
+
+VMMBackend::~VMMBackend()
+{
+	close();
+}
+
+bool VMMBackend::ReadMemoryMap(VMM_HANDLE handle, std::vector<TargetCache::MemoryRange>& ranges)
+{
+	PVMMDLL_MAP_PHYSMEM pPhysMemMap = nullptr;
+	if (!VMMDLL_Map_GetPhysMem(handle, &pPhysMemMap))
+	{
+		DMAHandler::log("Could not get the physical memory map\n");
+		return false;
+	}
+
+	if (pPhysMemMap->dwVersion != VMMDLL_MAP_PHYSMEM_VERSION)
+	{
+		DMAHandler::log("Invalid VMM Map Version\n");
+		VMMDLL_MemFree(pPhysMemMap);
+		return false;
+	}
+
+	ranges.clear();
+	for (DWORD i = 0; i < pPhysMemMap->cMap; i++)
+		ranges.push_back(TargetCache::MemoryRange{ pPhysMemMap->pMap[i].pa, pPhysMemMap->pMap[i].cb });
+
+	VMMDLL_MemFree(pPhysMemMap);
+	return true;
+}
+
+bool VMMBackend::ValidMemoryMap(const std::vector<TargetCache::MemoryRange>& ranges)
+{
+	if (ranges.empty())
+	{
+		DMAHandler::log("Empty memory map\n");
+		return false;
+	}
+
+	//a broken map makes reads of valid memory fail, so it is only used if every range is page aligned, ascending and not overlapping
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		const bool aligned = !(ranges[i].pa & 0xFFF) && ranges[i].cb && !(ranges[i].cb & 0xFFF);
+		const bool ascending = !i || ranges[i].pa >= ranges[i - 1].pa + ranges[i - 1].cb;
+		if (!aligned || !ascending)
+		{
+			DMAHandler::log("Invalid memory map range %zu: %llx - %llx\n", i, ranges[i].pa, ranges[i].pa + ranges[i].cb);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool VMMBackend::applyMemoryMap(const std::shared_ptr<TargetCache>& cache)
+{
+	//the cache only holds a map of this boot of the target, the fingerprint was checked on load
+	std::vector<TargetCache::MemoryRange> ranges = cache ? cache->getMemoryMap() : std::vector<TargetCache::MemoryRange>{};
+	const bool cached = !ranges.empty() && ValidMemoryMap(ranges);
+	if (!cached && (!ReadMemoryMap(vmmHandle, ranges) || !ValidMemoryMap(ranges)))
+		return false;
+
+	std::vector<LC_MEMMAP_ENTRY> entries;
+	entries.reserve(ranges.size());
+	for (const auto& range : ranges)
+		entries.push_back(LC_MEMMAP_ENTRY{ range.pa, range.cb, range.pa });
+
+	//the map goes straight to the device of this instance, no second instance and no mmap.txt
+	ULONG64 leechcore = 0;
+	if (!VMMDLL_ConfigGet(vmmHandle, VMMDLL_OPT_CORE_LEECHCORE_HANDLE, &leechcore) || !leechcore)
+	{
+		DMAHandler::log("Could not get the LeechCore handle\n");
+		return false;
+	}
+
+	if (!LcCommand((HANDLE)leechcore, LC_CMD_MEMMAP_SET_STRUCT, static_cast<DWORD>(entries.size() * sizeof(LC_MEMMAP_ENTRY)), reinterpret_cast<PBYTE>(entries.data()), nullptr, nullptr))
+	{
+		DMAHandler::log("Could not set the memory map\n");
+		return false;
+	}
+
+	//drop whatever was cached while reads still went to the unmapped ranges
+	VMMDLL_ConfigSet(vmmHandle, VMMDLL_OPT_REFRESH_ALL, 1);
+
+	if (cache && !cached)
+		cache->storeMemoryMap(ranges);
+
+	DMAHandler::log("Applied memory map with %zu ranges%s!", ranges.size(), cached ? " from the target cache" : "");
+	return true;
+}
+
+bool VMMBackend::isInitialized() const
+{
+	return vmmHandle != nullptr;
+}
+
+void VMMBackend::close()
+{
+	if (!vmmHandle)
+		return;
+
+	VMMDLL_Close(vmmHandle);
+	vmmHandle = nullptr;
+}
+
+ULONG64 VMMBackend::getTargetFingerprint()
+{
+	ULONG64 build = 0, systemId = 0;
+	VMMDLL_ConfigGet(vmmHandle, VMMDLL_OPT_WIN_VERSION_BUILD, &build);
+	VMMDLL_ConfigGet(vmmHandle, VMMDLL_OPT_WIN_SYSTEM_UNIQUE_ID, &systemId);
+	//the kernel is loaded at a new address every boot (KASLR), so its base tells two boots of the same system apart
+	const ULONG64 kernel = VMMDLL_ProcessGetModuleBaseU(vmmHandle, 4, (LPSTR)"ntoskrnl.exe");
+	if (!build || !kernel)
+		return 0;
+
+	ULONG64 fingerprint = 0xCBF29CE484222325ull;
+	for (const ULONG64 value : { build, systemId, kernel })
+		fingerprint = (fingerprint ^ value) * 0x100000001B3ull;
+	return fingerprint;
+}
+
+bool VMMBackend::getPidFromName(const char* processName, DWORD* pid)
+{
+	return VMMDLL_PidGetFromName(vmmHandle, const_cast<LPSTR>(processName), pid);
+}
+
+ULONG64 VMMBackend::getModuleBase(DWORD pid, const char* moduleName)
+{
+	return VMMDLL_ProcessGetModuleBaseU(vmmHandle, pid, const_cast<LPSTR>(moduleName));
+}
+
+bool VMMBackend::read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags)
+{
+	return VMMDLL_MemReadEx(vmmHandle, pid, address, buffer, size, bytesRead, flags & ~DMALIB_FLAG_NOPAGECACHE);
+}
+
+bool VMMBackend::write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	return VMMDLL_MemWrite(vmmHandle, pid, address, buffer, size);
+}
+
+bool VMMBackend::prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count)
+{
+	return VMMDLL_MemPrefetchPages(vmmHandle, pid, const_cast<PULONG64>(addresses), count);
+}
+
+VMMDLL_SCATTER_HANDLE VMMBackend::scatterInitialize(DWORD pid, DWORD flags)
+{
+	return VMMDLL_Scatter_Initialize(vmmHandle, pid, flags);
+}
+
+bool VMMBackend::scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	return VMMDLL_Scatter_PrepareEx(handle, address, size, buffer, bytesRead);
+}
+
+bool VMMBackend::scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size)
+{
+	return VMMDLL_Scatter_PrepareWrite(handle, address, buffer, size);
+}
+
+bool VMMBackend::scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle)
+{
+	return VMMDLL_Scatter_ExecuteRead(handle);
+}
+
+bool VMMBackend::scatterExecute(VMMDLL_SCATTER_HANDLE handle)
+{
+	return VMMDLL_Scatter_Execute(handle);
+}
+
+bool VMMBackend::scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead)
+{
+	return VMMDLL_Scatter_Read(handle, address, size, buffer, bytesRead);
+}
+
+bool VMMBackend::scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags)
+{
+	return VMMDLL_Scatter_Clear(handle, pid, flags);
+}
+
+void VMMBackend::scatterClose(VMMDLL_SCATTER_HANDLE handle)
+{
+	VMMDLL_Scatter_CloseHandle(handle);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "DMABackend.h"
+#include "TargetCache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Backend talking to the FPGA through MemProcFS (vmm.dll, leechcore.dll, FTD3XX.dll).
+ * Expects that all the libraries are in the root dir.
+ */
+class VMMBackend : public DMABackend
+{
+	struct LibModules
+	{
+		HMODULE VMM = nullptr;
+		HMODULE FTD3XX = nullptr;
+		HMODULE LEECHCORE = nullptr;
+	};
+
+	LibModules modules{};
+
+	VMM_HANDLE vmmHandle = nullptr;
+
+	// Reads the physical memory map of the target
+	static bool ReadMemoryMap(VMM_HANDLE handle, std::vector<TargetCache::MemoryRange>& ranges);
+
+	// Whether every range is page aligned and they are ascending without overlaps
+	static bool ValidMemoryMap(const std::vector<TargetCache::MemoryRange>& ranges);
+
+	// Sets the physical memory map on the device of the instance, taken from the cache if it holds one
+	bool applyMemoryMap(const std::shared_ptr<TargetCache>& cache);
+
+public:
+	/**
+	 * \brief loads the libraries and initializes the DMA
+	 * \param memMap whether the physical memory map of the target should be applied, so reads skip unbacked ranges
+	 * \param cache loaded for the target once it is initialized, the memory map is taken from it and stored in it
+	 * \param device LeechCore device string passed as -device, selects the board when several are attached (see DeviceGroupBackend)
+	 */
+	explicit VMMBackend(bool memMap = true, std::shared_ptr<TargetCache> cache = nullptr, const std::string& device = "fpga");
+
+	~VMMBackend() override;
+
+	const char* name() const override { return "vmm"; }
+
+	bool isInitialized() const override;
+
+	void close() override;
+
+	ULONG64 getTargetFingerprint() override;
+
+	// The raw VMM handle, for everything the backend does not wrap
+	VMM_HANDLE getHandle() const { return vmmHandle; }
+
+	bool getPidFromName(const char* processName, DWORD* pid) override;
+	ULONG64 getModuleBase(DWORD pid, const char* moduleName) override;
+
+	bool read(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size, DWORD* bytesRead, ULONG64 flags) override;
+	bool write(DWORD pid, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool prefetchPages(DWORD pid, const ULONG64* addresses, DWORD count) override;
+
+	VMMDLL_SCATTER_HANDLE scatterInitialize(DWORD pid, DWORD flags) override;
+	bool scatterPrepare(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterPrepareWrite(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, PBYTE buffer, DWORD size) override;
+	bool scatterExecuteRead(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterExecute(VMMDLL_SCATTER_HANDLE handle) override;
+	bool scatterRead(VMMDLL_SCATTER_HANDLE handle, ULONG64 address, DWORD size, PBYTE buffer, DWORD* bytesRead) override;
+	bool scatterClear(VMMDLL_SCATTER_HANDLE handle, DWORD pid, DWORD flags) override;
+	void scatterClose(VMMDLL_SCATTER_HANDLE handle) override;
+};
@@ -1,12 +1,18 @@
-#include <Windows.h>
+#include <cinttypes>
 #include <iostream>
 
+#include "AsyncDMAHandler.h"
+#include "BulkReader.h"
 #include "DMAHandler.h"
+#include "RemoteStruct.h"
+#include "ScatterBatch.h"
+#include "ScatterPipeline.h"
 
 
 int main()
 {
-	auto target = DMAHandler(L"MallocTest.exe");
+	//the memory map, pid and module bases are kept in target.cache, restarting before the target reboots skips their lookups
+	auto target = DMAHandler(L"MallocTest.exe", true, "target.cache");
 
 	//not initialized?
 	if (!target.isInitialized())
@@ -26,15 +32,15 @@ int main()
 	auto res = target.read<uint64_t>(target.getBaseAddress() + 0x3038);
 
 	//print the result
-	printf("result: %llu\n", res);
+	printf("result: %" PRIu64 "\n", res);
 
 	//write to the same address
-	target.write(target.getBaseAddress() + 0x3038, 12345678901122334455);
+	target.write(target.getBaseAddress() + 0x3038, 12345678901122334455ull);
 
 	//read again
 	res = target.read<uint64_t>(target.getBaseAddress() + 0x3038);
 
-	printf("result: %llu\n", res);
+	printf("result: %" PRIu64 "\n", res);
 
 	//Create a handle for scatter
 	auto handle = target.createScatterHandle();
@@ -47,8 +53,8 @@ int main()
 	target.executeScatterRead(handle);
 
 
-	printf("Read Scatter result: %llu\n", res);
-	printf("Read Scatter result2: %llu\n", res2);
+	printf("Read Scatter result: %" PRIu64 "\n", res);
+	printf("Read Scatter result2: %" PRIu64 "\n", res2);
 
 	//Always make sure you close your handle
 	target.closeScatterHandle(handle);
@@ -66,9 +72,89 @@ int main()
 	target.closeScatterHandle(handle);
 
 	//print the result via * operator
-	printf("Read Scatter result: %llu\n", *res1_1);
-	printf("Read Scatter result2: %llu\n", *res2_1);
+	printf("Read Scatter result: %" PRIu64 "\n", *res1_1);
+	printf("Read Scatter result2: %" PRIu64 "\n", *res2_1);
+
+	//Creating and closing a handle for every batch is wasted work, borrow one from the pool of the object instead.
+	//The lease hands it back cleared when it goes out of scope.
+	{
+		auto lease = target.acquireScatterHandle();
+		target.queueScatterReadEx(lease, target.getBaseAddress() + 0x3038, &res, sizeof(res));
+		target.executeScatterRead(lease);
+	}
+
+	printf("Pooled Scatter result: %" PRIu64 "\n", res);
+
+	//A ScatterBatch owns its handle and the memory of the values, the slots are only readable after execute
+	ScatterBatch batch(target);
+	auto res1_2 = batch.read<uint64_t>(target.getBaseAddress() + 0x3038);
+	auto res2_2 = batch.read<uint64_t>(target.getBaseAddress() + 0x3040);
+	batch.execute();
+
+	printf("Batch result: %" PRIu64 "\n", batch[res1_2]);
+	printf("Batch result2: %" PRIu64 "\n", batch[res2_2]);
+
+	//Many reads of the same type come back as one dense array, handy for lists of entities
+	batch.clear();
+	const ULONG64 addresses[] = { target.getBaseAddress() + 0x3038, target.getBaseAddress() + 0x3040, target.getBaseAddress() + 0x3048 };
+	auto values = batch.readArray<uint64_t>(addresses);
+	batch.execute();
+
+	for (const auto value : batch[values])
+		printf("Array result: %" PRIu64 "\n", value);
+
+	//The same fields of many objects, read in one scatter into one column per field
+	BulkReader<BulkField<0x0, uint64_t>, BulkField<0x8, uint32_t>> objects(target);
+	objects.read(addresses);
+
+	for (size_t i = 0; i < objects.size(); i++)
+		printf("Object %zu: %" PRIu64 " %u\n", i, objects.column<0>()[i], objects.column<1>()[i]);
+
+	//Declare the fields of a remote struct once, a view reads only the fields it names instead of the whole struct
+	struct Example
+	{
+		using first = RemoteField<0x3038, uint64_t>;
+		using second = RemoteField<0x3040, uint64_t>;
+		using far = RemoteField<0x3800, uint32_t>;
+	};
+
+	RemoteView<Example::first, Example::second, Example::far> view;
+	view.read(target, target.getBaseAddress());
+	printf("View result: %" PRIu64 " %" PRIu64 " %u\n", view.get<Example::first>(), view.get<Example::second>(), view.get<Example::far>());
+
+	//Reads of the same page within a frame can be served from a page cache, code of the main module never expires
+	const auto cache = target.enableReadCache();
+	target.setModuleCacheTTL("", PageCacheBackend::FOREVER);
 
+	res = target.read<uint64_t>(target.getBaseAddress() + 0x3038);
+	res2 = target.read<uint64_t>(target.getBaseAddress() + 0x3040);
+	printf("Cached results: %" PRIu64 " %" PRIu64 ", hit rate %.0f%%\n", res, res2, cache->getStats().hitRate() * 100);
+
+	//start the next frame
+	cache->advanceGeneration();
+
+	//Hint pages needed soon, they are fetched in the background while the current frame is processed
+	target.prefetch(target.getBaseAddress() + 0x4000, 0x2000);
+	res = target.read<uint64_t>(target.getBaseAddress() + 0x4000, ReadPolicy::cachedStatic());
+	printf("Prefetched result: %" PRIu64 "\n", res);
+
+	//Pointer chains can not be done in a single scatter, a ScatterPipeline resolves them level by level instead.
+	//All chains share one scatter round per level, so this costs 3 rounds no matter how many chains are added.
+	uint64_t chained = 0;
+	ScatterPipeline pipeline(&target);
+	pipeline.add(target.getBaseAddress() + 0x3000, { 0x10, 0x28, 0x8 }, &chained);
+	pipeline.execute();
+
+	printf("Pointer chain result: %" PRIu64 "\n", chained);
+
+
+	//Attach to another process on a worker thread, the device is connected already so only the pid is looked up
+	const auto explorer = AsyncDMAHandler::create(L"explorer.exe");
+	while (explorer->ready().wait_for(std::chrono::milliseconds(10)) != std::future_status::ready)
+		printf("explorer: %s\n", toString(explorer->getPhase()));
+
+	if (explorer->ready().get())
+		printf("explorer PID: 0x%X\n", explorer->get().getPID());
 
 	DMAHandler::closeDMA();
 
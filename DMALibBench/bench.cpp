@@ -0,0 +1,1806 @@
+// Microbenchmarks for the hot paths of DMALib, run against the stand-in backends so no device is needed.
+// Every run starts with a verify pass that checks the optimized paths against a plain reference and exits with 1 on a mismatch.
+// Usage: DMALibBench [--out results.json] [--filter name] [--quick] [--verify]
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncDMAHandler.h"
+#include "BulkReader.h"
+#include "CoalescingBackend.h"
+#include "DeviceGroupBackend.h"
+#include "DMAHandler.h"
+#include "FileBackend.h"
+#include "PageCacheBackend.h"
+#include "PatternScanner.h"
+#include "ReadPolicy.h"
+#include "RemoteStruct.h"
+#include "ScatterBatch.h"
+#include "ScatterPipeline.h"
+#include "SimulatedBackend.h"
+#include "TargetCacheBackend.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	constexpr auto PROCESS_NAME = "bench.exe";
+	constexpr auto WPROCESS_NAME = L"bench.exe";
+	constexpr DWORD PID = 1234;
+	constexpr ULONG64 MODULE_BASE = 0x140000000;
+	constexpr auto LIBRARY_NAME = "engine.dll";
+	constexpr ULONG64 LIBRARY_BASE = 0x7FFA00000000;
+	constexpr DWORD LIBRARY_TEXT_SIZE = 4 * 1024 * 1024;
+	constexpr ULONG64 HEAP_BASE = 0x7FF000000000;
+	constexpr ULONG64 HEAP_SIZE = 64ull * 1024 * 1024;
+
+	struct Result
+	{
+		std::string name;
+		std::string backend;
+		ULONG64 iterations = 0;
+		double opsPerSec = 0;
+		double bytesPerSec = 0;
+		double p50Ns = 0;
+		double p99Ns = 0;
+		double simulatedNsPerOp = 0;
+	};
+
+	struct Options
+	{
+		std::string out = "bench_results.json";
+		std::string filter;
+		bool quick = false;
+		// only run the verify pass
+		bool verify = false;
+	};
+
+	Options options;
+	std::vector<Result> results;
+	// mismatches found by the verify pass
+	int failures = 0;
+
+	/**
+	 * \brief builds a minimal PE image: dos header, nt headers, one .text section filled with noise
+	 * \param textSize size of the .text section
+	 */
+	std::vector<BYTE> buildModuleImage(DWORD textSize)
+	{
+		constexpr DWORD headerSize = 0x1000;
+		std::vector<BYTE> image(headerSize + textSize);
+
+		auto* dos = reinterpret_cast<IMAGE_DOS_HEADER*>(image.data());
+		dos->e_magic = IMAGE_DOS_SIGNATURE;
+		dos->e_lfanew = 0x80;
+
+		auto* nt = reinterpret_cast<IMAGE_NT_HEADERS*>(image.data() + dos->e_lfanew);
+		nt->Signature = IMAGE_NT_SIGNATURE;
+		nt->FileHeader.NumberOfSections = 1;
+		// no optional header, the section table directly follows the file header
+		nt->FileHeader.SizeOfOptionalHeader = 0;
+
+		IMAGE_SECTION_HEADER section{};
+		memcpy(section.Name, ".text", 5);
+		section.Misc.VirtualSize = textSize;
+		section.VirtualAddress = headerSize;
+		section.Characteristics = IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ | IMAGE_SCN_CNT_CODE;
+		memcpy(image.data() + dos->e_lfanew + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER), &section, sizeof(section));
+
+		std::mt19937 rng(1337);
+		for (DWORD i = headerSize; i < image.size(); i++)
+			image[i] = static_cast<BYTE>(rng());
+
+		return image;
+	}
+
+	std::shared_ptr<FileBackend> makeFileBackend(DWORD textSize)
+	{
+		auto backend = std::make_shared<FileBackend>(PROCESS_NAME, PID);
+
+		const auto module = buildModuleImage(textSize);
+		backend->addImage(MODULE_BASE, module.data(), module.size());
+		backend->addModule(PROCESS_NAME, MODULE_BASE);
+
+		const auto library = buildModuleImage(LIBRARY_TEXT_SIZE);
+		backend->addImage(LIBRARY_BASE, library.data(), library.size());
+		backend->addModule(LIBRARY_NAME, LIBRARY_BASE);
+
+		std::vector<BYTE> heap(HEAP_SIZE);
+		std::mt19937_64 rng(42);
+		for (size_t i = 0; i + sizeof(ULONG64) <= heap.size(); i += sizeof(ULONG64))
+		{
+			const ULONG64 value = rng();
+			memcpy(&heap[i], &value, sizeof(value));
+		}
+		backend->addImage(HEAP_BASE, heap.data(), heap.size());
+
+		return backend;
+	}
+
+	std::shared_ptr<DMABackend> makeBackend(const std::string& kind, DWORD textSize = 0x10000)
+	{
+		auto file = makeFileBackend(textSize);
+		if (kind == "file")
+			return file;
+
+		return std::make_shared<SimulatedBackend>(file);
+	}
+
+	ULONG64 simulatedNs(DMABackend* backend)
+	{
+		if (const auto* sim = dynamic_cast<SimulatedBackend*>(backend))
+			return sim->getStats().simulatedNs;
+		return 0;
+	}
+
+	/**
+	 * \brief runs fn samples * opsPerSample times. Every call is timed on its own for p50/p99, so a slow call
+	 * shows up in the percentiles instead of being averaged away by the other calls of its sample
+	 * \param bytesPerOp payload of one operation, used for bytes/sec
+	 */
+	void run(const std::string& name, const std::string& backendName, DMABackend* backend, ULONG64 samples, ULONG64 opsPerSample, double bytesPerOp, const std::function<void()>& fn)
+	{
+		const std::string fullName = name + "/" + backendName;
+		if (!options.filter.empty() && fullName.find(options.filter) == std::string::npos)
+			return;
+
+		if (options.quick)
+			samples = std::max<ULONG64>(1, samples / 10);
+
+		// warm up, faults in the pages and fills the caches
+		fn();
+
+		const ULONG64 simStart = simulatedNs(backend);
+		std::vector<double> opNs;
+		opNs.reserve(samples * opsPerSample);
+
+		// one clock read per call, the end of a call is the start of the next one
+		const auto start = std::chrono::steady_clock::now();
+		auto opStart = start;
+		for (ULONG64 i = 0; i < samples * opsPerSample; i++)
+		{
+			fn();
+			const auto opEnd = std::chrono::steady_clock::now();
+			opNs.push_back(std::chrono::duration<double, std::nano>(opEnd - opStart).count());
+			opStart = opEnd;
+		}
+		const double totalSec = std::chrono::duration<double>(opStart - start).count();
+
+		std::sort(opNs.begin(), opNs.end());
+
+		Result result;
+		result.name = name;
+		result.backend = backendName;
+		result.iterations = samples * opsPerSample;
+		result.opsPerSec = result.iterations / totalSec;
+		result.bytesPerSec = result.opsPerSec * bytesPerOp;
+		result.p50Ns = opNs[opNs.size() / 2];
+		result.p99Ns = opNs[std::min(opNs.size() - 1, opNs.size() * 99 / 100)];
+		result.simulatedNsPerOp = static_cast<double>(simulatedNs(backend) - simStart) / result.iterations;
+
+		printf("%-40s %12.0f ops/s %12.2f MB/s  p50 %10.0f ns  p99 %10.0f ns\n", fullName.c_str(), result.opsPerSec, result.bytesPerSec / 1024 / 1024, result.p50Ns, result.p99Ns);
+		results.push_back(result);
+	}
+
+	void benchRead(const std::string& kind)
+	{
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+
+		const ULONG64 samples = kind == "file" ? 2000 : 200;
+		ULONG64 offset = 0;
+
+		run("read<uint64_t>", kind, backend.get(), samples, 100, sizeof(uint64_t), [&]
+		{
+			offset = (offset + 0x1238) % (HEAP_SIZE - sizeof(uint64_t));
+			volatile auto value = handler.read<uint64_t>(HEAP_BASE + offset);
+			(void)value;
+		});
+
+		std::vector<BYTE> buffer(0x1000);
+		run("read/4096", kind, backend.get(), samples, 10, buffer.size(), [&]
+		{
+			offset = (offset + 0x11000) % (HEAP_SIZE - buffer.size());
+			handler.read(HEAP_BASE + offset, reinterpret_cast<ULONG64>(buffer.data()), buffer.size());
+		});
+	}
+
+	void benchScatter(const std::string& kind)
+	{
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+
+		for (const DWORD batchSize : { 1u, 16u, 128u, 1024u })
+		{
+			std::vector<uint64_t> values(batchSize);
+			std::mt19937_64 rng(batchSize);
+			auto handle = handler.createScatterHandle();
+
+			run("scatter/" + std::to_string(batchSize), kind, backend.get(), kind == "file" ? 500 : 100, 1, batchSize * sizeof(uint64_t), [&]
+			{
+				for (auto& value : values)
+					handler.queueScatterReadEx(handle, HEAP_BASE + (rng() % (HEAP_SIZE / 8)) * 8, &value, sizeof(value));
+				handler.executeScatterRead(handle);
+			});
+
+			handler.closeScatterHandle(handle);
+		}
+	}
+
+	void benchScatterObjects(const std::string& kind)
+	{
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+
+		constexpr DWORD batchSize = 256;
+		std::mt19937_64 rng(7);
+		auto handle = handler.createScatterHandle();
+
+		run("DMAScatter/" + std::to_string(batchSize), kind, backend.get(), kind == "file" ? 500 : 100, 1, batchSize * sizeof(uint64_t), [&]
+		{
+			std::vector<DMAScatter<uint64_t>> objects;
+			objects.reserve(batchSize);
+			for (DWORD i = 0; i < batchSize; i++)
+				objects.emplace_back(&handler, handle, HEAP_BASE + (rng() % (HEAP_SIZE / 8)) * 8);
+			handler.executeScatterRead(handle);
+
+			uint64_t sum = 0;
+			for (auto& object : objects)
+				sum += *object;
+			volatile auto keep = sum;
+			(void)keep;
+		});
+
+		handler.closeScatterHandle(handle);
+
+		// same reads, values in one buffer owned by the batch and reused every frame
+		ScatterBatch batch(handler, batchSize);
+		std::vector<ScatterSlot<uint64_t>> slots;
+		slots.reserve(batchSize);
+
+		run("ScatterBatch/" + std::to_string(batchSize), kind, backend.get(), kind == "file" ? 500 : 100, 1, batchSize * sizeof(uint64_t), [&]
+		{
+			batch.clear();
+			slots.clear();
+			for (DWORD i = 0; i < batchSize; i++)
+				slots.push_back(batch.read<uint64_t>(HEAP_BASE + (rng() % (HEAP_SIZE / 8)) * 8));
+			batch.execute();
+
+			uint64_t sum = 0;
+			for (const auto slot : slots)
+				sum += batch[slot];
+			volatile auto keep = sum;
+			(void)keep;
+		});
+	}
+
+	void benchScatterArena(const std::string& kind)
+	{
+		// thousands of reads per frame, the case where destination locality matters
+		constexpr size_t batchSize = 4096;
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+		std::mt19937_64 rng(9);
+
+		std::vector<ULONG64> addresses(batchSize);
+		auto shuffle = [&]
+		{
+			for (auto& address : addresses)
+				address = HEAP_BASE + (rng() % (HEAP_SIZE / 8)) * 8;
+		};
+
+		const auto handle = handler.acquireScatterHandle();
+		run("DMAScatter/" + std::to_string(batchSize), kind, backend.get(), kind == "file" ? 200 : 20, 1, batchSize * sizeof(uint64_t), [&]
+		{
+			shuffle();
+			// one heap object per read, the way DMAScatter is used
+			std::vector<std::unique_ptr<DMAScatter<uint64_t>>> objects;
+			objects.reserve(batchSize);
+			for (const auto address : addresses)
+				objects.push_back(std::make_unique<DMAScatter<uint64_t>>(&handler, handle, address));
+			handler.executeScatterRead(handle);
+
+			uint64_t sum = 0;
+			for (auto& object : objects)
+				sum += **object;
+			volatile auto keep = sum;
+			(void)keep;
+		});
+
+		ScatterBatch batch(handler, batchSize);
+		run("ScatterBatch/array/" + std::to_string(batchSize), kind, backend.get(), kind == "file" ? 200 : 20, 1, batchSize * sizeof(uint64_t), [&]
+		{
+			shuffle();
+			batch.clear();
+			const auto values = batch.readArray<uint64_t>(addresses);
+			batch.execute();
+
+			uint64_t sum = 0;
+			for (const auto value : batch[values])
+				sum += value;
+			volatile auto keep = sum;
+			(void)keep;
+		});
+
+		const auto stats = batch.getArena().getStats();
+		if (stats.highWater)
+			printf("  arena: %zu B high water, %zu B capacity, %zu block allocations\n", stats.highWater, stats.capacity, stats.blockAllocations);
+	}
+
+	void benchBulkRead(const std::string& kind)
+	{
+		// three 8 byte fields of 2048 objects, the shape of an entity list walk
+		constexpr size_t objectCount = 2048;
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+		std::mt19937_64 rng(13);
+
+		std::vector<ULONG64> bases(objectCount);
+		for (auto& base : bases)
+			base = HEAP_BASE + (rng() % (HEAP_SIZE / 0x100 - 1)) * 0x100;
+
+		struct Object
+		{
+			uint64_t a, b, c;
+		};
+		std::vector<Object> objects(objectCount);
+
+		run("bulk/2048x3/perField", kind, backend.get(), kind == "file" ? 200 : 20, 1, objectCount * sizeof(Object), [&]
+		{
+			const auto handle = handler.acquireScatterHandle();
+			for (size_t i = 0; i < objectCount; i++)
+			{
+				handler.queueScatterReadEx(handle, bases[i] + 0x10, &objects[i].a, sizeof(uint64_t));
+				handler.queueScatterReadEx(handle, bases[i] + 0x18, &objects[i].b, sizeof(uint64_t));
+				handler.queueScatterReadEx(handle, bases[i] + 0x28, &objects[i].c, sizeof(uint64_t));
+			}
+			handler.executeScatterRead(handle);
+		});
+
+		BulkReader<BulkField<0x10, uint64_t>, BulkField<0x18, uint64_t>, BulkField<0x28, uint64_t>> reader(handler);
+		run("bulk/2048x3/BulkReader", kind, backend.get(), kind == "file" ? 200 : 20, 1, objectCount * sizeof(Object), [&]
+		{
+			reader.read(bases);
+		});
+	}
+
+	void benchRemoteStruct(const std::string& kind)
+	{
+		// two fields of a 2KB struct, once as read<T> of the whole struct and once as a view of the two fields
+		struct Entity
+		{
+			uint8_t data[0x800];
+		};
+		struct EntityLayout
+		{
+			using health = RemoteField<0x1C, int>;
+			using flags = RemoteField<0x20, uint32_t>;
+			using position = RemoteField<0x640, uint64_t>;
+		};
+
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+		const ULONG64 entity = HEAP_BASE + 0x10000;
+
+		run("struct/2KB/read<T>", kind, backend.get(), kind == "file" ? 2000 : 200, 10, sizeof(Entity), [&]
+		{
+			const auto value = handler.read<Entity>(entity);
+			volatile auto keep = value.data[0x1C] + value.data[0x640];
+			(void)keep;
+		});
+
+		RemoteView<EntityLayout::health, EntityLayout::flags> adjacent;
+		run("struct/2KB/view/adjacent", kind, backend.get(), kind == "file" ? 2000 : 200, 10, adjacent.transferSize(), [&]
+		{
+			adjacent.read(handler, entity);
+			volatile auto keep = adjacent.get<EntityLayout::health>() + adjacent.get<EntityLayout::flags>();
+			(void)keep;
+		});
+
+		RemoteView<EntityLayout::health, EntityLayout::position> apart;
+		run("struct/2KB/view/apart", kind, backend.get(), kind == "file" ? 2000 : 200, 10, apart.transferSize(), [&]
+		{
+			apart.read(handler, entity);
+			volatile auto keep = apart.get<EntityLayout::health>() + apart.get<EntityLayout::position>();
+			(void)keep;
+		});
+	}
+
+	void benchScatterHandles(const std::string& kind)
+	{
+		// a small batch, so handle setup is a noticeable part of the frame
+		constexpr size_t batchSize = 16;
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+		std::vector<uint64_t> values(batchSize);
+		std::mt19937_64 rng(5);
+
+		run("scatter/16/createClose", kind, backend.get(), kind == "file" ? 500 : 100, 1, batchSize * sizeof(uint64_t), [&]
+		{
+			auto handle = handler.createScatterHandle();
+			for (auto& value : values)
+				handler.queueScatterReadEx(handle, HEAP_BASE + (rng() % (HEAP_SIZE / 8)) * 8, &value, sizeof(value));
+			handler.executeScatterRead(handle);
+			handler.closeScatterHandle(handle);
+		});
+
+		run("scatter/16/pooled", kind, backend.get(), kind == "file" ? 500 : 100, 1, batchSize * sizeof(uint64_t), [&]
+		{
+			const auto handle = handler.acquireScatterHandle();
+			for (auto& value : values)
+				handler.queueScatterReadEx(handle, HEAP_BASE + (rng() % (HEAP_SIZE / 8)) * 8, &value, sizeof(value));
+			handler.executeScatterRead(handle);
+		});
+
+		const auto stats = handler.getScatterPool()->getStats();
+		if (stats.hits || stats.misses)
+			printf("  pool: %llu hits, %llu misses\n", stats.hits, stats.misses);
+	}
+
+	void benchPointerChains(const std::string& kind)
+	{
+		// 64 chains base -> +0x10 -> +0x28 -> +0x8 -> value, every node on its own heap page
+		constexpr size_t chainCount = 64;
+		constexpr ULONG64 nodeStride = 0x1000;
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+
+		std::vector<ULONG64> bases(chainCount);
+		for (size_t i = 0; i < chainCount; i++)
+		{
+			const ULONG64 first = HEAP_BASE + (i * 3) * nodeStride;
+			const ULONG64 second = first + nodeStride;
+			const ULONG64 third = second + nodeStride;
+			bases[i] = first;
+			handler.write<ULONG64>(first + 0x10, second);
+			handler.write<ULONG64>(second + 0x28, third);
+		}
+
+		std::vector<uint64_t> values(chainCount);
+
+		run("chains/64x3/blocking", kind, backend.get(), kind == "file" ? 500 : 20, 1, chainCount * sizeof(uint64_t), [&]
+		{
+			for (size_t i = 0; i < chainCount; i++)
+			{
+				const auto second = handler.read<ULONG64>(bases[i] + 0x10);
+				const auto third = handler.read<ULONG64>(second + 0x28);
+				values[i] = handler.read<uint64_t>(third + 0x8);
+			}
+		});
+
+		ScatterPipeline pipeline(&handler);
+		for (size_t i = 0; i < chainCount; i++)
+			pipeline.add(bases[i], { 0x10, 0x28, 0x8 }, &values[i]);
+
+		run("chains/64x3/pipeline", kind, backend.get(), kind == "file" ? 500 : 100, 1, chainCount * sizeof(uint64_t), [&]
+		{
+			pipeline.execute();
+		});
+	}
+
+	void benchCoalescing()
+	{
+		// 32 entities with 8 fields each 0x10 apart, the typical shape of a frame of reads
+		constexpr size_t entities = 32;
+		constexpr size_t fields = 8;
+		std::vector<ULONG64> addresses;
+		std::mt19937_64 rng(11);
+		for (size_t e = 0; e < entities; e++)
+		{
+			const ULONG64 entity = HEAP_BASE + (rng() % (HEAP_SIZE / 0x1000 - 1)) * 0x1000 + 0x100;
+			for (size_t f = 0; f < fields; f++)
+				addresses.push_back(entity + f * 0x10);
+		}
+		std::vector<uint64_t> values(addresses.size());
+
+		auto sim = std::make_shared<SimulatedBackend>(makeFileBackend(0x10000));
+		for (const bool coalesce : { false, true })
+		{
+			DMAHandler handler(WPROCESS_NAME, sim);
+			std::shared_ptr<CoalescingBackend> coalescing;
+			if (coalesce)
+				coalescing = handler.enableScatterCoalescing();
+
+			auto handle = handler.createScatterHandle();
+			run(std::string("scatter/fields/256/") + (coalesce ? "coalesced" : "plain"), "sim", sim.get(), 100, 1, values.size() * sizeof(uint64_t), [&]
+			{
+				for (size_t i = 0; i < addresses.size(); i++)
+					handler.queueScatterReadEx(handle, addresses[i], &values[i], sizeof(uint64_t));
+				handler.executeScatterRead(handle);
+			});
+			handler.closeScatterHandle(handle);
+
+			if (coalescing && coalescing->getStats().requests)
+			{
+				const auto stats = coalescing->getStats();
+				printf("  %llu requests -> %llu spans, %llu merged\n", stats.requests, stats.spans, stats.merged);
+			}
+		}
+	}
+
+	void benchPageCache()
+	{
+		// a frame of 16 field reads spread over 4 objects, every object read a second time later in the frame
+		std::vector<ULONG64> addresses;
+		for (ULONG64 object = 0; object < 4; object++)
+		{
+			for (ULONG64 field = 0; field < 4; field++)
+				addresses.push_back(HEAP_BASE + 0x20000 + object * 0x3000 + field * 0x18);
+		}
+
+		auto sim = std::make_shared<SimulatedBackend>(makeFileBackend(0x10000));
+		for (const bool cached : { false, true })
+		{
+			DMAHandler handler(WPROCESS_NAME, sim);
+			std::shared_ptr<PageCacheBackend> cache;
+			if (cached)
+				cache = handler.enableReadCache();
+
+			run(std::string("read/frame/32/") + (cached ? "cached" : "plain"), "sim", sim.get(), 50, 1, 2 * addresses.size() * sizeof(uint64_t), [&]
+			{
+				if (cache)
+					cache->advanceGeneration();
+
+				uint64_t sum = 0;
+				for (int pass = 0; pass < 2; pass++)
+				{
+					for (const auto address : addresses)
+						sum += handler.read<uint64_t>(address);
+				}
+				volatile auto keep = sum;
+				(void)keep;
+			});
+
+			if (cache && cache->getStats().hits)
+			{
+				const auto stats = cache->getStats();
+				printf("  hit rate %.1f%%, %llu B saved\n", stats.hitRate() * 100, stats.bytesSaved);
+			}
+		}
+	}
+
+	void benchReadPolicies()
+	{
+		// 64 fields on 16 pages read every frame, once as plain reads and once as one scatter batch
+		std::vector<ULONG64> addresses;
+		for (ULONG64 page = 0; page < 16; page++)
+		{
+			for (ULONG64 field = 0; field < 4; field++)
+				addresses.push_back(HEAP_BASE + 0x40000 + page * 0x1000 + field * 0x40);
+		}
+
+		const std::pair<const char*, ReadPolicy> policies[] = {
+			{ "realtime", ReadPolicy::realtime() },
+			{ "freshest", ReadPolicy::freshest() },
+			{ "cachedStatic", ReadPolicy::cachedStatic() },
+			{ "forensicComplete", ReadPolicy::forensicComplete() },
+		};
+
+		for (const auto& [name, policy] : policies)
+		{
+			auto sim = std::make_shared<SimulatedBackend>(makeFileBackend(0x10000));
+			DMAHandler handler(WPROCESS_NAME, sim);
+			const auto cache = handler.enableReadCache();
+			handler.setReadPolicy(policy);
+
+			run(std::string("policy/read/64/") + name, "sim", sim.get(), 50, 1, addresses.size() * sizeof(uint64_t), [&]
+			{
+				cache->advanceGeneration();
+
+				uint64_t sum = 0;
+				for (const auto address : addresses)
+					sum += handler.read<uint64_t>(address);
+				volatile auto keep = sum;
+				(void)keep;
+			});
+
+			ScatterBatch batch(handler, addresses.size());
+			batch.setPolicy(policy);
+			const auto values = batch.readArray<uint64_t>(addresses);
+
+			run(std::string("policy/scatter/64/") + name, "sim", sim.get(), 50, 1, addresses.size() * sizeof(uint64_t), [&]
+			{
+				batch.execute();
+
+				uint64_t sum = 0;
+				for (const auto value : batch[values])
+					sum += value;
+				volatile auto keep = sum;
+				(void)keep;
+			});
+		}
+	}
+
+	// Stand-in for 1ms of game logic consuming a frame of reads
+	uint64_t processFrame(const std::vector<uint64_t>& values)
+	{
+		const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(1000);
+		uint64_t sum = 0;
+		while (std::chrono::steady_clock::now() < until)
+		{
+			for (const auto value : values)
+				sum += value;
+		}
+		return sum;
+	}
+
+	void benchPrefetch()
+	{
+		// every frame reads 64 fields on 16 pages it did not touch before, then processes them.
+		// With prefetch the pages of the next frame are hinted before the processing starts
+		constexpr ULONG64 pagesPerFrame = 16;
+		auto sim = std::make_shared<SimulatedBackend>(makeFileBackend(0x10000));
+
+		for (const bool hinted : { false, true })
+		{
+			DMAHandler handler(WPROCESS_NAME, sim);
+			handler.setReadPolicy(ReadPolicy::cachedStatic());
+			ULONG64 frame = 0;
+
+			auto frameAddress = [](ULONG64 frame, ULONG64 page, ULONG64 field)
+			{
+				return HEAP_BASE + (frame * pagesPerFrame + page) % (HEAP_SIZE / 0x1000) * 0x1000 + field * 0x40;
+			};
+
+			run(std::string("frame/prefetch/64/") + (hinted ? "hinted" : "plain"), "sim", sim.get(), 100, 1, 64 * sizeof(uint64_t), [&]
+			{
+				if (hinted)
+				{
+					std::vector<ULONG64> next;
+					for (ULONG64 page = 0; page < pagesPerFrame; page++)
+						next.push_back(frameAddress(frame + 1, page, 0));
+					handler.prefetch(next);
+				}
+
+				std::vector<uint64_t> values;
+				for (ULONG64 page = 0; page < pagesPerFrame; page++)
+				{
+					for (ULONG64 field = 0; field < 4; field++)
+						values.push_back(handler.read<uint64_t>(frameAddress(frame, page, field)));
+				}
+
+				volatile auto keep = processFrame(values);
+				(void)keep;
+				frame++;
+			});
+		}
+	}
+
+	void benchAsyncScatter(const std::string& kind)
+	{
+		constexpr size_t batchSize = 256;
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+		std::mt19937_64 rng(3);
+
+		auto prepare = [&](VMMDLL_SCATTER_HANDLE handle, std::vector<uint64_t>& values)
+		{
+			for (auto& value : values)
+				handler.queueScatterReadEx(handle, HEAP_BASE + (rng() % (HEAP_SIZE / 8)) * 8, &value, sizeof(value));
+		};
+
+		// prepare, execute, process one frame after the other
+		{
+			std::vector<uint64_t> values(batchSize);
+			auto handle = handler.createScatterHandle();
+
+			run("frame/sync/256", kind, backend.get(), 100, 1, batchSize * sizeof(uint64_t), [&]
+			{
+				prepare(handle, values);
+				handler.executeScatterRead(handle);
+				volatile auto keep = processFrame(values);
+				(void)keep;
+			});
+
+			handler.closeScatterHandle(handle);
+		}
+
+		// double buffered, the next frame is read while the previous one is processed
+		{
+			std::vector<uint64_t> values[2] = { std::vector<uint64_t>(batchSize), std::vector<uint64_t>(batchSize) };
+			VMMDLL_SCATTER_HANDLE handles[2] = { handler.createScatterHandle(), handler.createScatterHandle() };
+			int current = 0;
+
+			prepare(handles[current], values[current]);
+			auto pending = handler.executeScatterReadAsync(handles[current]);
+
+			run("frame/async/256", kind, backend.get(), 100, 1, batchSize * sizeof(uint64_t), [&]
+			{
+				const int next = current ^ 1;
+				prepare(handles[next], values[next]);
+
+				pending.get();
+				auto inFlight = handler.executeScatterReadAsync(handles[next]);
+
+				volatile auto keep = processFrame(values[current]);
+				(void)keep;
+
+				pending = std::move(inFlight);
+				current = next;
+			});
+
+			pending.get();
+			handler.closeScatterHandle(handles[0]);
+			handler.closeScatterHandle(handles[1]);
+		}
+	}
+
+	void benchPatternScan()
+	{
+		constexpr DWORD textSize = 64 * 1024 * 1024;
+		auto backend = makeBackend("file", textSize);
+		DMAHandler handler(WPROCESS_NAME, backend);
+
+		// a pattern that never matches forces a full pass over the section
+		const char* pattern = "\x48\x8B\x05\x00\x00\x00\x00\x48\x85\xC0\x74\x00\xDE\xAD\xBE\xEF";
+		const std::string mask = "xxx????xxxx?xxxx";
+
+		run("patternScan/miss/64MB", "file", backend.get(), 5, 1, textSize, [&]
+		{
+			volatile auto address = handler.patternScan(pattern, mask, false);
+			(void)address;
+		});
+
+		// the images of both modules stay cached side by side, switching between them reads nothing
+		run("patternScan/miss/" + std::string(LIBRARY_NAME), "file", backend.get(), 50, 1, LIBRARY_TEXT_SIZE, [&]
+		{
+			volatile auto address = handler.patternScan(pattern, mask, false, LIBRARY_NAME);
+			(void)address;
+		});
+
+		// every "48 8B ? ? ?" in 64MB of noise, around 4k matches
+		const Signature common = Signature::fromIDA("48 8B ? ? ?");
+		run("patternScanAll/64MB", "file", backend.get(), 5, 1, textSize, [&]
+		{
+			size_t count = 0;
+			for (const auto& match : handler.patternScanAll(common))
+				count += match.found();
+			volatile auto keep = count;
+			(void)keep;
+		});
+
+		// 32 IDA signatures with wildcards resolved in one pass, compare against 32x the single scan above
+		std::vector<std::string> signatures;
+		std::mt19937 rng(99);
+		for (int i = 0; i < 32; i++)
+		{
+			std::string signature;
+			for (int j = 0; j < 12; j++)
+			{
+				char byte[4];
+				snprintf(byte, sizeof(byte), "%02X ", static_cast<unsigned>(rng() & 0xFF));
+				signature += (j == 3 || j == 4) ? "? " : byte;
+			}
+			signatures.push_back(signature);
+		}
+
+		run("patternScan/batch32/64MB", "file", backend.get(), 5, 1, textSize, [&]
+		{
+			volatile auto addresses = handler.patternScan(signatures, false).size();
+			(void)addresses;
+		});
+	}
+
+	// The masked compare loop patternScan used before the SIMD kernels, kept here as the baseline
+	size_t legacyScan(const char* data, size_t size, const char* pattern, const std::string& mask)
+	{
+		auto CheckMask = [](const char* Base, const char* Pattern, const char* Mask) {
+			for (; *Mask; ++Base, ++Pattern, ++Mask) {
+				if (*Mask == 'x' && *Base != *Pattern) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		const int length = static_cast<int>(size) - static_cast<int>(mask.length());
+		for (int i = 0; i <= length; ++i)
+		{
+			if (CheckMask(data + i, pattern, mask.c_str()))
+				return i;
+		}
+		return PatternScanner::NOT_FOUND;
+	}
+
+	void check(bool condition, const std::string& what)
+	{
+		if (condition)
+			return;
+
+		failures++;
+		printf("FAIL %s\n", what.c_str());
+	}
+
+	// Random pattern + mask pair with at least one fixed byte
+	std::pair<std::string, std::string> randomPattern(std::mt19937_64& rng, size_t length)
+	{
+		std::string pattern(length, '\0'), mask(length, 'x');
+		for (size_t i = 0; i < length; i++)
+		{
+			pattern[i] = static_cast<char>(rng());
+			if (rng() % 4 == 0)
+				mask[i] = '?';
+		}
+		mask[rng() % length] = 'x';
+		return { pattern, mask };
+	}
+
+	void verifyBackends()
+	{
+		// plain and scatter reads through the handler, on the file backend and behind the simulated link, against the file backend itself
+		auto file = makeFileBackend(0x10000);
+		SimulatedLinkConfig link;
+		link.realTime = false;
+		const std::vector<std::pair<std::string, std::shared_ptr<DMABackend>>> backends{ { "file", file }, { "sim", std::make_shared<SimulatedBackend>(file, link) } };
+
+		std::mt19937_64 rng(20);
+		for (const auto& [kind, backend] : backends)
+		{
+			DMAHandler handler(WPROCESS_NAME, backend);
+			for (int i = 0; i < 64; i++)
+			{
+				const ULONG64 address = HEAP_BASE + rng() % (HEAP_SIZE - 0x2000);
+				const DWORD size = 1 + rng() % 0x2000;
+				std::vector<BYTE> expected(size), value(size);
+				file->read(PID, address, expected.data(), size, nullptr, 0);
+				handler.read(address, reinterpret_cast<ULONG64>(value.data()), size);
+				check(value == expected, kind + " read " + std::to_string(i));
+			}
+
+			std::vector<ULONG64> addresses(256);
+			std::vector<uint64_t> values(addresses.size());
+			auto handle = handler.createScatterHandle();
+			for (size_t i = 0; i < addresses.size(); i++)
+			{
+				addresses[i] = HEAP_BASE + rng() % (HEAP_SIZE - sizeof(uint64_t));
+				handler.queueScatterReadEx(handle, addresses[i], &values[i], sizeof(uint64_t));
+			}
+			handler.executeScatterRead(handle);
+			handler.closeScatterHandle(handle);
+
+			for (size_t i = 0; i < addresses.size(); i++)
+			{
+				uint64_t expected = 0;
+				file->read(PID, addresses[i], reinterpret_cast<PBYTE>(&expected), sizeof(expected), nullptr, 0);
+				check(values[i] == expected, kind + " scatter entry " + std::to_string(i));
+			}
+		}
+	}
+
+	void verifyScanKernels()
+	{
+		std::mt19937_64 rng(21);
+		for (int round = 0; round < 200; round++)
+		{
+			// odd sizes, so the kernels run into their tails
+			std::vector<char> buffer(4096 + rng() % 4096);
+			for (auto& byte : buffer)
+				byte = static_cast<char>(rng() % 8);
+
+			auto [pattern, mask] = randomPattern(rng, 1 + rng() % 80);
+			for (auto& byte : pattern)
+				byte = static_cast<char>(static_cast<unsigned char>(byte) % 8);
+			if (pattern.size() <= buffer.size() && rng() % 4)
+			{
+				const size_t at = rng() % 2 ? rng() % (buffer.size() - pattern.size() + 1) : buffer.size() - pattern.size();
+				memcpy(buffer.data() + at, pattern.data(), pattern.size());
+			}
+
+			const size_t expected = legacyScan(buffer.data(), buffer.size(), pattern.c_str(), mask);
+			const Signature signature = Signature::fromMask(pattern.data(), mask);
+			const auto* data = reinterpret_cast<const uint8_t*>(buffer.data());
+			for (const auto level : { ScanLevel::Scalar, ScanLevel::SSE42, ScanLevel::AVX2, ScanLevel::AVX512 })
+			{
+				if (level > PatternScanner::detectLevel())
+					break;
+				check(PatternScanner::findFirst(data, buffer.size(), signature, level) == expected, std::string("scanKernel/") + PatternScanner::levelName(level) + " round " + std::to_string(round));
+			}
+		}
+	}
+
+	void verifyBatchScan()
+	{
+		// the single pass batch against a byte by byte search per signature, 48 signatures share most of their anchor bytes
+		std::mt19937_64 rng(22);
+		std::vector<uint8_t> buffer(256 * 1024);
+		for (auto& byte : buffer)
+			byte = static_cast<uint8_t>(rng());
+
+		std::vector<Signature> signatures;
+		for (int i = 0; i < 48; i++)
+		{
+			const auto [pattern, mask] = randomPattern(rng, 4 + rng() % 12);
+			signatures.push_back(Signature::fromMask(pattern.data(), mask));
+			if (i % 3 == 0)
+				memcpy(buffer.data() + rng() % (buffer.size() - pattern.size()), pattern.data(), pattern.size());
+		}
+
+		auto firstMatch = [&](const Signature& signature)
+		{
+			for (size_t offset = 0; offset + signature.size() <= buffer.size(); offset++)
+			{
+				size_t i = 0;
+				while (i < signature.size() && (!signature.mask[i] || buffer[offset + i] == signature.bytes[i]))
+					i++;
+				if (i == signature.size())
+					return offset;
+			}
+			return PatternScanner::NOT_FOUND;
+		};
+
+		std::vector<size_t> expected;
+		for (const auto& signature : signatures)
+			expected.push_back(firstMatch(signature));
+
+		const PatternScanner scanner(signatures);
+		const auto found = scanner.scanFirst(buffer.data(), buffer.size());
+		for (size_t i = 0; i < signatures.size(); i++)
+			check(found[i] == expected[i], "scanFirst signature " + std::to_string(i));
+
+		// once with every signature fixed in its first two bytes, so all of them are anchored on a pair, and once more with
+		// a signature that has no two adjacent fixed bytes, which turns the pair filter off
+		std::vector<Signature> paired = signatures;
+		for (auto& signature : paired)
+			std::fill_n(signature.mask.begin(), 2, 0xFF);
+		char pairless[16];
+		snprintf(pairless, sizeof(pairless), "? %02X ? %02X", buffer[0x1234], buffer[0x1236]);
+
+		for (const bool withPairless : { false, true })
+		{
+			if (withPairless)
+				paired.push_back(Signature::fromIDA(pairless));
+
+			const auto pairedFound = PatternScanner(paired).scanFirst(buffer.data(), buffer.size());
+			for (size_t i = 0; i < paired.size(); i++)
+				check(pairedFound[i] == firstMatch(paired[i]), std::string(withPairless ? "pairless" : "paired") + " scanFirst signature " + std::to_string(i));
+		}
+
+		// the same buffer as two regions listed out of address order, in shards smaller than a region
+		ThreadPool pool(2);
+		const std::vector<ScanRegion> regions{ { buffer.data() + 0x20000, buffer.size() - 0x20000, 0x20000 }, { buffer.data(), 0x20000, 0 } };
+		const auto lowest = scanner.scanLowest(regions, pool, 0x4000);
+		for (size_t i = 0; i < signatures.size(); i++)
+		{
+			const auto single = PatternScanner::findLowest(regions, signatures[i], pool, 0x4000);
+			check(single.found() == (expected[i] != PatternScanner::NOT_FOUND) && (!single.found() || single.address == expected[i]), "findLowest signature " + std::to_string(i));
+			check(lowest[i].found() == single.found() && lowest[i].address == single.address, "scanLowest signature " + std::to_string(i));
+		}
+	}
+
+	void verifyCoalescing()
+	{
+		// overlapping, adjacent and page crossing reads, coalesced against plain reads of the same backend
+		auto file = makeFileBackend(0x10000);
+		CoalescingConfig singlePage, gapOnly;
+		singlePage.mergeAcrossPages = false;
+		gapOnly.mergeWithinPage = false;
+		gapOnly.maxGap = 8;
+
+		for (const auto& [name, config] : { std::pair{ "default", CoalescingConfig{} }, std::pair{ "singlePage", singlePage }, std::pair{ "gapOnly", gapOnly } })
+		{
+			CoalescingBackend coalescing(file, config);
+
+			std::mt19937_64 rng(23);
+			std::vector<ULONG64> addresses;
+			std::vector<DWORD> sizes;
+			for (int i = 0; i < 256; i++)
+			{
+				addresses.push_back(HEAP_BASE + 0x3000 + rng() % 0x8000);
+				sizes.push_back(1 + rng() % (i % 16 ? 16 : 0x1800));
+			}
+			// one read at the end of the heap, one right behind it on the unmapped page after
+			addresses.push_back(HEAP_BASE + HEAP_SIZE - 8);
+			sizes.push_back(8);
+			addresses.push_back(HEAP_BASE + HEAP_SIZE);
+			sizes.push_back(8);
+
+			std::vector<std::vector<BYTE>> values(addresses.size());
+			std::vector<DWORD> read(addresses.size());
+			const auto handle = coalescing.scatterInitialize(PID, VMMDLL_FLAG_NOCACHE);
+			for (size_t i = 0; i < addresses.size(); i++)
+			{
+				values[i].resize(sizes[i]);
+				coalescing.scatterPrepare(handle, addresses[i], sizes[i], values[i].data(), &read[i]);
+			}
+			coalescing.scatterExecuteRead(handle);
+			coalescing.scatterClose(handle);
+
+			for (size_t i = 0; i + 2 < addresses.size(); i++)
+			{
+				std::vector<BYTE> expected(sizes[i]);
+				file->read(PID, addresses[i], expected.data(), sizes[i], nullptr, 0);
+				check(values[i] == expected && read[i] == sizes[i], std::string(name) + " coalesced scatter entry " + std::to_string(i));
+			}
+
+			// merged, the span comes back partially and nobody knows which page failed
+			const DWORD heapEnd = config.mergeAcrossPages ? 0 : 8;
+			check(read[read.size() - 2] == heapEnd && read.back() == 0, std::string(name) + " coalesced scatter entries around a failed page");
+		}
+
+		// how many spans two reads turn into under every rule
+		const auto spansOf = [&](const CoalescingConfig& config, ULONG64 first, ULONG64 second)
+		{
+			DMAHandler handler(WPROCESS_NAME, file);
+			auto coalescing = handler.enableScatterCoalescing(config);
+			uint64_t values[2];
+			auto handle = handler.createScatterHandle();
+			handler.queueScatterReadEx(handle, first, &values[0], sizeof(uint64_t));
+			handler.queueScatterReadEx(handle, second, &values[1], sizeof(uint64_t));
+			handler.executeScatterRead(handle);
+			handler.closeScatterHandle(handle);
+			return coalescing->getStats().spans;
+		};
+
+		const ULONG64 page = HEAP_BASE + 0x5000;
+		check(spansOf({}, page + 0x10, page + 0xF00) == 1, "coalescing merges any gap within a page");
+		check(spansOf(gapOnly, page + 0x10, page + 0xF00) == 2, "coalescing keeps maxGap within a page without mergeWithinPage");
+		check(spansOf(gapOnly, page + 0x10, page + 0x1C) == 1, "coalescing merges within maxGap without mergeWithinPage");
+		check(spansOf({}, page - 0x10, page + 0x20) == 1, "coalescing merges close reads across a page boundary");
+		check(spansOf(singlePage, page - 0x10, page + 0x20) == 2, "coalescing keeps pages apart without mergeAcrossPages");
+		check(spansOf({}, page - 0x10, page + 0x100) == 2, "coalescing keeps reads past maxGap on the next page apart");
+	}
+
+	void verifyPipeline()
+	{
+		constexpr size_t chainCount = 16;
+		auto file = makeFileBackend(0x10000);
+		DMAHandler handler(WPROCESS_NAME, file);
+
+		std::vector<ULONG64> bases(chainCount);
+		for (size_t i = 0; i < chainCount; i++)
+		{
+			bases[i] = HEAP_BASE + i * 0x3000;
+			handler.write<ULONG64>(bases[i] + 0x10, bases[i] + 0x1000);
+			handler.write<ULONG64>(bases[i] + 0x1000 + 0x28, bases[i] + 0x2000);
+		}
+
+		std::vector<uint64_t> values(chainCount);
+		ScatterPipeline pipeline(&handler);
+		for (size_t i = 0; i < chainCount; i++)
+			pipeline.add(bases[i], { 0x10, 0x28, 0x8 }, &values[i]);
+		pipeline.execute();
+
+		for (size_t i = 0; i < chainCount; i++)
+		{
+			const auto second = handler.read<ULONG64>(bases[i] + 0x10);
+			const auto third = handler.read<ULONG64>(second + 0x28);
+			check(pipeline.resolved(i) && pipeline.address(i) == third + 0x8 && values[i] == handler.read<uint64_t>(third + 0x8), "pipeline chain " + std::to_string(i));
+		}
+	}
+
+	void verifyRemoteReads()
+	{
+		// fields declared out of order, two of them overlapping and one far from the rest, against a plain read of the whole struct
+		using A = RemoteField<0x18, uint32_t>;
+		using B = RemoteField<0x10, uint64_t>;
+		using C = RemoteField<0x14, uint16_t>;
+		using D = RemoteField<0x1F0, std::array<char, 12>>;
+		constexpr size_t structSize = 0x200;
+
+		auto file = makeFileBackend(0x10000);
+		DMAHandler handler(WPROCESS_NAME, file);
+
+		std::vector<ULONG64> bases;
+		for (size_t i = 0; i < 64; i++)
+			bases.push_back(i % 5 == 3 ? 0 : HEAP_BASE + 0x10000 + i * 0x2A8);
+
+		const auto field = [&](ULONG64 base, auto descriptor)
+		{
+			using Field = decltype(descriptor);
+			std::array<uint8_t, structSize> whole{};
+			if (base)
+				handler.read(base, reinterpret_cast<ULONG64>(whole.data()), whole.size());
+			typename Field::type value;
+			memcpy(&value, whole.data() + Field::offset, sizeof(value));
+			return value;
+		};
+
+		BulkReader<A, B, C, D> bulk(handler);
+		check(bulk.read(bases) && bulk.size() == bases.size() && bulk.entriesPerObject() == 2, "bulk read");
+		for (size_t i = 0; i < bases.size(); i++)
+		{
+			const bool matches = bulk.column<0>()[i] == field(bases[i], A{}) && bulk.column<1>()[i] == field(bases[i], B{})
+				&& bulk.column<2>()[i] == field(bases[i], C{}) && bulk.column<3>()[i] == field(bases[i], D{});
+			check(matches, "bulk read object " + std::to_string(i) + (bases[i] ? "" : " (null base)"));
+		}
+
+		for (const ULONG64 base : { bases[0], bases[1] })
+		{
+			RemoteView<A, B, C, D> split;
+			RemoteView<C, A, B> packed;
+			static_assert(RemoteView<A, B, C, D>::spanCount() == 2 && RemoteView<C, A, B>::spanCount() == 1);
+			check(split.read(handler, base) && packed.read(handler, base), "remote view read");
+			check(split.get<A>() == field(base, A{}) && split.get<B>() == field(base, B{}) && split.get<C>() == field(base, C{}) && split.get<D>() == field(base, D{}), "remote view fields over two spans");
+			check(packed.get<A>() == field(base, A{}) && packed.get<B>() == field(base, B{}) && packed.get<C>() == field(base, C{}), "remote view fields in one span");
+		}
+
+		// the single span path reports a failed read like the scatter path does
+		RemoteView<C, A, B> unmapped;
+		check(!unmapped.read(handler, HEAP_BASE + HEAP_SIZE + 0x100000), "remote view read of unmapped memory fails");
+	}
+
+	void verifyScatterPool()
+	{
+		auto file = makeFileBackend(0x10000);
+		DMAHandler handler(WPROCESS_NAME, file);
+
+		// pooled handles start empty, what the previous lease queued but never executed is dropped
+		uint64_t stale = 0;
+		{
+			auto lease = handler.acquireScatterHandle();
+			handler.queueScatterReadEx(lease, HEAP_BASE, &stale, sizeof(stale));
+		}
+
+		std::vector<uint64_t> values(64, 0);
+		{
+			auto lease = handler.acquireScatterHandle();
+			for (size_t i = 0; i < values.size(); i++)
+				handler.queueScatterReadEx(lease, HEAP_BASE + i * 0x1008, &values[i], sizeof(uint64_t));
+			handler.executeScatterRead(lease);
+		}
+		for (size_t i = 0; i < values.size(); i++)
+			check(values[i] == handler.read<uint64_t>(HEAP_BASE + i * 0x1008), "pooled scatter entry " + std::to_string(i));
+		check(stale == 0, "pooled scatter handle starts empty");
+		check(handler.getScatterPool()->getStats().hits != 0, "scatter pool reuses handles");
+
+		// a lease that is out when the pool is replaced keeps the old pool alive and goes back to it
+		std::weak_ptr<ScatterHandlePool> old = handler.getScatterPool();
+		auto lease = handler.acquireScatterHandle();
+		handler.enableScatterCoalescing();
+		handler.enableReadCache();
+		check(!old.expired() && old.lock() != handler.getScatterPool(), "replaced scatter pool lives while a lease is out");
+		lease.reset();
+		check(old.expired(), "replaced scatter pool is released with its last lease");
+
+		uint64_t value = 0;
+		auto fresh = handler.acquireScatterHandle();
+		handler.queueScatterReadEx(fresh, HEAP_BASE + 0x2468, &value, sizeof(value));
+		handler.executeScatterRead(fresh);
+		check(value == handler.read<uint64_t>(HEAP_BASE + 0x2468), "scatter pool after the backend changed");
+	}
+
+	void verifyPageCache()
+	{
+		auto file = makeFileBackend(0x10000);
+		DMAHandler handler(WPROCESS_NAME, file);
+		auto cache = handler.enableReadCache();
+
+		std::mt19937_64 rng(24);
+		for (int i = 0; i < 64; i++)
+		{
+			// the second read of every address comes from the cache
+			const ULONG64 address = HEAP_BASE + rng() % 0x10000;
+			const DWORD size = 1 + rng() % 0x1800;
+			std::vector<BYTE> expected(size), first(size), second(size);
+			file->read(PID, address, expected.data(), size, nullptr, 0);
+			handler.read(address, reinterpret_cast<ULONG64>(first.data()), size);
+			handler.read(address, reinterpret_cast<ULONG64>(second.data()), size);
+			check(first == expected && second == expected, "page cache read " + std::to_string(i));
+		}
+		check(cache->getStats().hits != 0, "page cache hits");
+
+		{
+			// a full cache drops the least recently used pages, a page read between every miss stays
+			PageCacheConfig small;
+			small.maxPages = 64;
+			PageCacheBackend bounded(file, small);
+			const ULONG64 hot = HEAP_BASE + 0x100;
+			for (ULONG64 page = 1; page <= 256; page++)
+			{
+				uint64_t value = 0, expected = 0;
+				bounded.read(PID, hot, reinterpret_cast<PBYTE>(&value), sizeof(value), nullptr, 0);
+				bounded.read(PID, hot + page * 0x1000, reinterpret_cast<PBYTE>(&value), sizeof(value), nullptr, 0);
+				file->read(PID, hot + page * 0x1000, reinterpret_cast<PBYTE>(&expected), sizeof(expected), nullptr, 0);
+				check(value == expected, "page cache read past maxPages " + std::to_string(page));
+			}
+			const auto stats = bounded.getStats();
+			check(stats.hits == 255 && stats.misses == 257, "page cache keeps the recently used page when full");
+			// 257 pages stored, at least 60 of them are still cached
+			check(stats.evictions <= 257 - 60, "page cache evicts a batch, not the whole cache");
+		}
+
+		// pages that never expire have to follow plain and scatter writes
+		cache->setRegionTTL(PID, HEAP_BASE, 0x10000, PageCacheBackend::FOREVER);
+		const ULONG64 address = HEAP_BASE + 0x2010;
+		handler.write<uint32_t>(address, 0x11111111);
+		check(handler.read<uint32_t>(address) == 0x11111111 && handler.read<uint32_t>(address) == 0x11111111, "page cache read before a write");
+
+		handler.write<uint32_t>(address, 0x22222222);
+		check(handler.read<uint32_t>(address) == 0x22222222, "page cache read after a plain write");
+
+		uint32_t value = 0x33333333;
+		auto handle = handler.createScatterHandle();
+		handler.queueScatterWriteEx(handle, address, &value, sizeof(value));
+		// the write is not on the device yet, this read caches the old bytes again
+		check(handler.read<uint32_t>(address) == 0x22222222, "page cache read with a queued scatter write");
+		handler.executeScatterWrite(handle);
+		handler.closeScatterHandle(handle);
+		check(handler.read<uint32_t>(address) == 0x33333333, "page cache read after a scatter write");
+
+		// reads racing with writes must not leave old bytes behind once the writes are done
+		std::thread writer([&]
+		{
+			for (uint32_t i = 0; i <= 2000; i++)
+				handler.write<uint32_t>(address, i);
+		});
+		for (int i = 0; i < 2000; i++)
+			(void)handler.read<uint32_t>(address);
+		writer.join();
+		check(handler.read<uint32_t>(address) == 2000, "page cache read after concurrent writes");
+	}
+
+	void verifyReadPolicy()
+	{
+		auto file = makeFileBackend(0x10000);
+		DMAHandler handler(WPROCESS_NAME, file);
+		handler.enableReadCache();
+
+		const ULONG64 address = HEAP_BASE + 0x4321;
+		for (const auto& [name, policy] : { std::pair{ "realtime", ReadPolicy::realtime() }, std::pair{ "freshest", ReadPolicy::freshest() },
+			std::pair{ "cachedStatic", ReadPolicy::cachedStatic() }, std::pair{ "forensicComplete", ReadPolicy::forensicComplete() } })
+		{
+			// a lease taken under the previous policy stays usable after the scatter flags changed
+			std::weak_ptr<ScatterHandlePool> old = handler.getScatterPool();
+			auto lease = handler.acquireScatterHandle();
+			const bool flagsChange = policy.scatterFlags != handler.getReadPolicy().scatterFlags;
+			handler.setReadPolicy(policy);
+
+			uint64_t value = 0;
+			handler.queueScatterReadEx(lease, address, &value, sizeof(value));
+			handler.executeScatterRead(lease);
+			lease.reset();
+
+			uint64_t expected = 0;
+			file->read(PID, address, reinterpret_cast<PBYTE>(&expected), sizeof(expected), nullptr, 0);
+			check(value == expected && handler.read<uint64_t>(address) == expected && handler.read<uint64_t>(address, policy) == expected, std::string("read policy ") + name);
+			check(!flagsChange || old.expired(), std::string("read policy ") + name + " releases the old scatter pool");
+		}
+
+		// bytes changed behind the handler's back: the cached page is served unless the policy bypasses the cache
+		handler.setReadPolicy(ReadPolicy::realtime());
+		const auto cached = handler.read<uint64_t>(address);
+		uint64_t changed = ~cached;
+		file->write(PID, address, reinterpret_cast<PBYTE>(&changed), sizeof(changed));
+		check(handler.read<uint64_t>(address) == cached, "read policy realtime uses the page cache");
+		check(handler.read<uint64_t>(address, ReadPolicy::freshest()) == changed, "read policy freshest bypasses the page cache");
+	}
+
+	void verifyTargetCache()
+	{
+		auto file = makeFileBackend(0x10000);
+		const std::string path = (std::filesystem::temp_directory_path() / "dmalib_verify_target.cache").string();
+		std::filesystem::remove(path);
+		const ULONG64 fingerprint = file->getTargetFingerprint();
+
+		DWORD pid = 0;
+		TargetCacheBackend(file, std::make_shared<TargetCache>(path)).getPidFromName(PROCESS_NAME, &pid);
+		std::ifstream in(path, std::ios::binary);
+		const std::vector<char> saved{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+		in.close();
+
+		// loads the saved file with the bytes at offset replaced, the header is magic, version, fingerprint and the three counts
+		const auto loadPatched = [&](size_t offset, const std::vector<char>& bytes, size_t length)
+		{
+			std::vector<char> patched(saved.begin(), saved.begin() + std::min(length, saved.size()));
+			std::copy(bytes.begin(), bytes.end(), patched.begin() + offset);
+			std::ofstream(path, std::ios::binary | std::ios::trunc).write(patched.data(), static_cast<std::streamsize>(patched.size()));
+
+			TargetCache cache(path);
+			const bool loaded = cache.load(fingerprint);
+			DWORD cached = 0;
+			return loaded || !cache.getMemoryMap().empty() || cache.findPid(PROCESS_NAME, &cached);
+		};
+
+		check(pid == PID && loadPatched(0, {}, saved.size()), "target cache loads its own file");
+		check(!loadPatched(4, { 2, 0, 0, 0 }, saved.size()), "target cache rejects another version");
+		check(!loadPatched(8, { static_cast<char>(saved[8] ^ 1) }, saved.size()), "target cache rejects another fingerprint");
+		check(!loadPatched(0, {}, saved.size() - 1), "target cache rejects a truncated file");
+		for (size_t count = 0; count < 3; count++)
+		{
+			// one count above the cap, one below it that still does not fit the file
+			check(!loadPatched(16 + count * 4, { '\xFF', '\xFF', '\xFF', '\xFF' }, saved.size()), "target cache rejects count " + std::to_string(count) + " above the cap");
+			check(!loadPatched(16 + count * 4, { 0, 0x10, 0, 0 }, saved.size()), "target cache rejects count " + std::to_string(count) + " past the end of the file");
+		}
+
+		// a pid from an earlier boot of the process: its main module does not read back as an image
+		auto cache = std::make_shared<TargetCache>(path);
+		cache->load(fingerprint);
+		cache->storePid(PROCESS_NAME, PID + 4);
+		cache->storeModuleBase(PID + 4, PROCESS_NAME, MODULE_BASE);
+		TargetCacheBackend cached(file, cache);
+		check(cached.getPidFromName(PROCESS_NAME, &pid) && pid == PID && cache->getStats().rejected == 1, "target cache rejects a stale pid");
+
+		TargetCache reloaded(path);
+		reloaded.load(fingerprint);
+		check(reloaded.findPid(PROCESS_NAME, &pid) && pid == PID, "target cache saves the pid that replaced a stale one");
+		std::filesystem::remove(path);
+	}
+
+	void verifyDeviceGroup()
+	{
+		// three devices with different queue depths, one without any link model
+		auto file = makeFileBackend(0x10000);
+		SimulatedLinkConfig link;
+		link.realTime = false;
+		DeviceGroupConfig config;
+		config.queueDepths = { 3, 5 };
+		auto group = std::make_shared<DeviceGroupBackend>(std::vector<std::shared_ptr<DMABackend>>{
+			std::make_shared<SimulatedBackend>(file, link), std::make_shared<SimulatedBackend>(file, link), file }, config);
+		DMAHandler handler(WPROCESS_NAME, group);
+
+		std::vector<BYTE> expected(0x30000), bulk(0x30000);
+		file->read(PID, HEAP_BASE + 0x123, expected.data(), static_cast<DWORD>(expected.size()), nullptr, 0);
+		handler.read(HEAP_BASE + 0x123, reinterpret_cast<ULONG64>(bulk.data()), bulk.size());
+		check(bulk == expected, "device group read");
+
+		std::vector<uint64_t> values(64);
+		auto handle = handler.createScatterHandle();
+		for (size_t i = 0; i < values.size(); i++)
+			handler.queueScatterReadEx(handle, HEAP_BASE + i * 0x1100, &values[i], sizeof(uint64_t));
+		handler.executeScatterRead(handle);
+		handler.closeScatterHandle(handle);
+
+		for (size_t i = 0; i < values.size(); i++)
+			check(values[i] == handler.read<uint64_t>(HEAP_BASE + i * 0x1100), "device group scatter entry " + std::to_string(i));
+
+		for (const auto& stats : group->getStats())
+			check(stats.entries != 0, "device group uses every device");
+	}
+
+	void verifyScatterBatch()
+	{
+		// single values, arrays and values of a shared arena against plain reads, then the same batch cleared and reused
+		auto file = makeFileBackend(0x10000);
+		DMAHandler handler(WPROCESS_NAME, file);
+		std::mt19937_64 rng(23);
+
+		auto expect = [&]<typename T>(ULONG64 address)
+		{
+			T value{};
+			file->read(PID, address, reinterpret_cast<PBYTE>(&value), sizeof(T), nullptr, 0);
+			return value;
+		};
+
+		ScatterBatch batch(handler);
+		size_t allocations = 0;
+		for (int frame = 0; frame < 3; frame++)
+		{
+			std::vector<ULONG64> addresses(64), arrayAddresses(48);
+			for (auto& address : addresses)
+				address = HEAP_BASE + rng() % (HEAP_SIZE - 0x20);
+			for (auto& address : arrayAddresses)
+				address = HEAP_BASE + rng() % (HEAP_SIZE - 0x20);
+
+			std::vector<ScatterSlot<uint64_t>> values;
+			for (const ULONG64 address : addresses)
+				values.push_back(batch.read<uint64_t>(address));
+			const auto array = batch.readArray<uint32_t>(arrayAddresses);
+			const auto blob = batch.read<std::array<char, 24>>(addresses[0] + 3);
+			check(batch.execute(), "scatter batch execute, frame " + std::to_string(frame));
+
+			const std::string suffix = ", frame " + std::to_string(frame);
+			for (size_t i = 0; i < addresses.size(); i++)
+				check(batch[values[i]] == expect.operator()<uint64_t>(addresses[i]), "scatter batch value " + std::to_string(i) + suffix);
+			for (size_t i = 0; i < arrayAddresses.size(); i++)
+				check(batch[array][i] == expect.operator()<uint32_t>(arrayAddresses[i]), "scatter batch array value " + std::to_string(i) + suffix);
+			check(batch[blob] == expect.operator()<std::array<char, 24>>(addresses[0] + 3), "scatter batch struct" + suffix);
+
+			// executing again rereads the same addresses
+			handler.write<uint64_t>(addresses[1], ~batch[values[1]]);
+			batch.execute();
+			check(batch[values[1]] == expect.operator()<uint64_t>(addresses[1]), "scatter batch refresh" + suffix);
+
+			// from the second frame on the reset arena is one block that fits the whole frame
+			batch.clear();
+			if (frame == 1)
+				allocations = batch.getArena().getStats().blockAllocations;
+		}
+		check(batch.getArena().getStats().blockAllocations == allocations, "scatter batch reuses its arena");
+
+		ScatterArena shared;
+		ScatterBatch first(handler, shared), second(handler, shared);
+		const auto a = first.read<uint64_t>(HEAP_BASE + 0x1001);
+		const auto b = second.read<uint64_t>(HEAP_BASE + 0x2002);
+		first.execute();
+		second.execute();
+		check(first[a] == expect.operator()<uint64_t>(HEAP_BASE + 0x1001) && second[b] == expect.operator()<uint64_t>(HEAP_BASE + 0x2002), "scatter batches on a shared arena");
+	}
+
+	void verifyPrefetch()
+	{
+		// pages hinted through the prefetch thread end up in the data cache of the link and read the same as without the hint
+		auto file = makeFileBackend(0x10000);
+		SimulatedLinkConfig link;
+		link.realTime = false;
+		auto sim = std::make_shared<SimulatedBackend>(file, link);
+		DMAHandler handler(WPROCESS_NAME, sim);
+		handler.setReadPolicy(ReadPolicy::cachedStatic());
+
+		constexpr ULONG64 pages = 16;
+		handler.prefetch(HEAP_BASE + 0x10800, pages * 0x1000);
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (sim->getStats().pages < pages && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		check(sim->getStats().pages >= pages, "prefetch reaches the backend");
+
+		const auto cached = sim->getStats().cachedPages;
+		for (ULONG64 i = 0; i < pages * 4; i++)
+		{
+			const ULONG64 address = HEAP_BASE + 0x10800 + i * 0x400;
+			uint64_t expected = 0;
+			file->read(PID, address, reinterpret_cast<PBYTE>(&expected), sizeof(expected), nullptr, 0);
+			check(handler.read<uint64_t>(address) == expected, "prefetched read " + std::to_string(i));
+		}
+		check(sim->getStats().cachedPages - cached == pages * 4, "prefetched reads are served from the data cache");
+	}
+
+	void verifyPatternScanAll()
+	{
+		// every match of the lazy scan against a byte by byte search over the section, read with plain reads
+		constexpr DWORD textSize = 0x40000;
+		auto file = makeFileBackend(textSize);
+		DMAHandler handler(WPROCESS_NAME, file);
+
+		const std::vector<std::pair<std::string, DWORD>> modules{ { "", textSize }, { LIBRARY_NAME, LIBRARY_TEXT_SIZE } };
+		for (const auto& [module, size] : modules)
+		{
+			const ULONG64 text = (module.empty() ? MODULE_BASE : LIBRARY_BASE) + 0x1000;
+			std::vector<BYTE> section(size);
+			file->read(PID, text, section.data(), size, nullptr, 0);
+
+			char tail[16];
+			snprintf(tail, sizeof(tail), "%02X ? %02X", section[size - 3], section[size - 1]);
+			for (const std::string& ida : { std::string("C3"), std::string("48 8B ? ?"), std::string(tail), std::string("DE AD BE EF 00 11 22 33") })
+			{
+				const Signature signature = Signature::fromIDA(ida);
+				std::vector<ULONG64> expected;
+				for (size_t offset = 0; offset + signature.size() <= section.size(); offset++)
+				{
+					size_t i = 0;
+					while (i < signature.size() && (!signature.mask[i] || section[offset + i] == signature.bytes[i]))
+						i++;
+					if (i == signature.size())
+						expected.push_back(text + offset);
+				}
+
+				const std::string what = "patternScanAll " + (module.empty() ? std::string(PROCESS_NAME) : module) + " \"" + ida + "\"";
+				const MatchRange range = handler.patternScanAll(signature, module);
+				std::vector<ULONG64> found;
+				for (const auto& match : range)
+					found.push_back(match.address);
+				check(found == expected, what);
+
+				const auto limited = range.collect(3);
+				check(limited.size() == std::min<size_t>(3, expected.size()), what + " collect(3) size");
+				for (size_t i = 0; i < limited.size(); i++)
+					check(limited[i].address == expected[i], what + " collect(3) match " + std::to_string(i));
+			}
+		}
+	}
+
+	void verifyAsyncHandler()
+	{
+		// a handler brought up on the worker reads the same as the backend, an unknown process fails instead of hanging
+		auto file = makeFileBackend(0x10000);
+		auto async = AsyncDMAHandler::create(WPROCESS_NAME, { .memMap = false, .cacheFile = {}, .backend = file });
+		check(async->ready().get() && async->isReady(), "async handler ready");
+
+		for (ULONG64 i = 0; i < 16; i++)
+		{
+			const ULONG64 address = HEAP_BASE + i * 0x1234;
+			uint64_t expected = 0;
+			file->read(PID, address, reinterpret_cast<PBYTE>(&expected), sizeof(expected), nullptr, 0);
+			check(async->get().read<uint64_t>(address) == expected, "async handler read " + std::to_string(i));
+		}
+		check(async->get().getBaseAddress() == MODULE_BASE, "async handler base address");
+
+		auto missing = AsyncDMAHandler::create(L"missing.exe", { .memMap = false, .cacheFile = {}, .backend = file });
+		check(!missing->ready().get() && missing->getPhase() == DMAInitPhase::Failed, "async handler of a missing process fails");
+	}
+
+	// Checks the optimized paths against their plain reference, returns the amount of mismatches
+	int verify()
+	{
+		verifyBackends();
+		verifyScanKernels();
+		verifyBatchScan();
+		verifyCoalescing();
+		verifyPipeline();
+		verifyRemoteReads();
+		verifyScatterPool();
+		verifyPageCache();
+		verifyReadPolicy();
+		verifyTargetCache();
+		verifyDeviceGroup();
+		verifyScatterBatch();
+		verifyPrefetch();
+		verifyPatternScanAll();
+		verifyAsyncHandler();
+
+		printf("verify: %s\n", failures ? "FAILED" : "ok");
+		return failures;
+	}
+
+	void benchScanKernels()
+	{
+		constexpr size_t size = 64 * 1024 * 1024;
+		std::vector<char> buffer(size);
+		std::mt19937_64 rng(7);
+		for (auto& byte : buffer)
+			byte = static_cast<char>(rng());
+
+		const char* pattern = "\x48\x8B\x05\x00\x00\x00\x00\x48\x85\xC0\x74\x00\xDE\xAD\xBE\xEF";
+		const std::string mask = "xxx????xxxx?xxxx";
+		const Signature signature = Signature::fromMask(pattern, mask);
+		const auto* data = reinterpret_cast<const uint8_t*>(buffer.data());
+
+		// kernels only, no backend involved
+		run("scanKernel/legacy/64MB", "memory", nullptr, 5, 1, size, [&]
+		{
+			volatile auto offset = legacyScan(buffer.data(), size, pattern, mask);
+			(void)offset;
+		});
+
+		for (const auto level : { ScanLevel::Scalar, ScanLevel::SSE42, ScanLevel::AVX2, ScanLevel::AVX512 })
+		{
+			if (level > PatternScanner::detectLevel())
+				break;
+
+			run(std::string("scanKernel/") + PatternScanner::levelName(level) + "/64MB", "memory", nullptr, 10, 1, size, [&]
+			{
+				volatile auto offset = PatternScanner::findFirst(data, size, signature, level);
+				(void)offset;
+			});
+		}
+	}
+
+	void benchShardedScan()
+	{
+		constexpr size_t size = 256 * 1024 * 1024;
+		std::vector<uint8_t> buffer(size);
+		std::mt19937_64 rng(8);
+		for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+		{
+			const uint64_t value = rng();
+			memcpy(&buffer[i], &value, sizeof(value));
+		}
+
+		// four executable sections of a packed module
+		std::vector<ScanRegion> regions;
+		for (size_t i = 0; i < 4; i++)
+			regions.push_back(ScanRegion{ buffer.data() + i * size / 4, size / 4, MODULE_BASE + 0x1000 + i * 0x10000000 });
+
+		const Signature signature = Signature::fromIDA("48 8B 05 ? ? ? ? 48 85 C0 74 ? DE AD BE EF");
+
+		ThreadPool single(1);
+		run("scanSharded/threads=1/256MB", "memory", nullptr, 5, 1, size, [&]
+		{
+			volatile auto match = PatternScanner::findLowest(regions, signature, single).found();
+			(void)match;
+		});
+
+		ThreadPool& pool = ThreadPool::shared();
+		if (pool.size() == 1)
+			return;
+
+		run("scanSharded/threads=" + std::to_string(pool.size()) + "/256MB", "memory", nullptr, 10, 1, size, [&]
+		{
+			volatile auto match = PatternScanner::findLowest(regions, signature, pool).found();
+			(void)match;
+		});
+	}
+
+	void benchConstruction(const std::string& kind)
+	{
+		auto backend = makeBackend(kind);
+
+		run("DMAHandler()", kind, backend.get(), kind == "file" ? 500 : 100, 1, 0, [&]
+		{
+			DMAHandler handler(WPROCESS_NAME, backend);
+			volatile auto base = handler.getBaseAddress();
+			(void)base;
+		});
+
+		// a warm restart, every iteration loads the file the first one wrote
+		const std::string cacheFile = (std::filesystem::temp_directory_path() / "dmalib_bench_target.cache").string();
+		std::filesystem::remove(cacheFile);
+
+		run("DMAHandler()/targetcache", kind, backend.get(), kind == "file" ? 500 : 100, 1, 0, [&]
+		{
+			auto cached = std::make_shared<TargetCacheBackend>(backend, std::make_shared<TargetCache>(cacheFile));
+			DMAHandler handler(WPROCESS_NAME, cached);
+			volatile auto base = handler.getBaseAddress();
+			(void)base;
+		});
+		std::filesystem::remove(cacheFile);
+	}
+
+	void benchThreads(const std::string& kind)
+	{
+		// one handler shared by all workers, every worker reads its own part of the heap. Throughput grows with the cores on
+		// the file backend, the simulated link serves one request at a time and stays flat, see benchDeviceGroup for more links
+		auto backend = makeBackend(kind);
+		DMAHandler handler(WPROCESS_NAME, backend);
+
+		const ULONG64 readsPerWorker = kind == "file" ? 2000 : 16;
+		const size_t maxThreads = std::max<size_t>(4, std::thread::hardware_concurrency());
+
+		for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			ThreadPool workers(threads);
+			const auto parallel = [&](const std::function<void(size_t)>& work)
+			{
+				std::vector<std::future<void>> done;
+				for (size_t worker = 0; worker < threads; worker++)
+					done.push_back(workers.submit([&work, worker] { work(worker); }));
+				for (auto& future : done)
+					future.get();
+			};
+
+			run("mt/read/threads=" + std::to_string(threads), kind, backend.get(), kind == "file" ? 100 : 20, 1, threads * readsPerWorker * sizeof(uint64_t), [&]
+			{
+				parallel([&](size_t worker)
+				{
+					ULONG64 offset = worker * (HEAP_SIZE / threads);
+					for (ULONG64 i = 0; i < readsPerWorker; i++)
+					{
+						offset = (offset + 0x1238) % (HEAP_SIZE - sizeof(uint64_t));
+						volatile auto value = handler.read<uint64_t>(HEAP_BASE + offset);
+						(void)value;
+					}
+				});
+			});
+
+			run("mt/scatter/64/threads=" + std::to_string(threads), kind, backend.get(), kind == "file" ? 100 : 20, 1, threads * 64 * sizeof(uint64_t), [&]
+			{
+				parallel([&](size_t worker)
+				{
+					ScatterBatch batch(handler, 64);
+					for (ULONG64 i = 0; i < 64; i++)
+						batch.read<uint64_t>(HEAP_BASE + (worker * 64 + i) * 0x1040 % HEAP_SIZE);
+					batch.execute();
+				});
+			});
+		}
+	}
+
+	void benchAsyncInit()
+	{
+		// attaching to several processes, one after the other vs all at once on their own workers
+		constexpr int processes = 4;
+		auto sim = std::make_shared<SimulatedBackend>(makeFileBackend(0x10000));
+
+		run("init/attach/" + std::to_string(processes) + "/sequential", "sim", sim.get(), 100, 1, 0, [&]
+		{
+			for (int i = 0; i < processes; i++)
+			{
+				DMAHandler handler(WPROCESS_NAME, sim);
+				volatile auto pid = handler.getPID();
+				(void)pid;
+			}
+		});
+
+		run("init/attach/" + std::to_string(processes) + "/async", "sim", sim.get(), 100, 1, 0, [&]
+		{
+			std::vector<std::unique_ptr<AsyncDMAHandler>> handlers;
+			for (int i = 0; i < processes; i++)
+				handlers.push_back(AsyncDMAHandler::create(WPROCESS_NAME, { .memMap = true, .cacheFile = {}, .backend = sim }));
+
+			for (const auto& handler : handlers)
+			{
+				volatile auto pid = handler->get().getPID();
+				(void)pid;
+			}
+		});
+	}
+
+	void benchDeviceGroup()
+	{
+		// the same target behind 1, 2 and 4 simulated devices, aggregate bandwidth should grow with the devices
+		auto file = makeFileBackend(0x10000);
+		constexpr DWORD entries = 256;
+		constexpr DWORD bulkSize = 1024 * 1024;
+		std::vector<BYTE> bulk(bulkSize);
+
+		for (size_t count = 1; count <= 4; count *= 2)
+		{
+			std::vector<std::shared_ptr<DMABackend>> devices;
+			for (size_t i = 0; i < count; i++)
+				devices.push_back(std::make_shared<SimulatedBackend>(file));
+
+			auto group = std::make_shared<DeviceGroupBackend>(devices);
+			DMAHandler handler(WPROCESS_NAME, group);
+			const std::string suffix = "/devices=" + std::to_string(count);
+
+			run("devices/scatter/" + std::to_string(entries) + suffix, "sim", group.get(), 20, 1, entries * sizeof(uint64_t), [&]
+			{
+				ScatterBatch batch(handler, entries);
+				for (DWORD i = 0; i < entries; i++)
+					batch.read<uint64_t>(HEAP_BASE + i * 0x1040ull % HEAP_SIZE);
+				batch.execute();
+			});
+
+			run("devices/read/1mb" + suffix, "sim", group.get(), 10, 1, bulkSize, [&]
+			{
+				handler.read(HEAP_BASE, reinterpret_cast<ULONG64>(bulk.data()), bulkSize);
+			});
+		}
+	}
+
+	void writeJson()
+	{
+		FILE* file = fopen(options.out.c_str(), "w");
+		if (!file)
+		{
+			printf("could not open %s\n", options.out.c_str());
+			return;
+		}
+
+		fprintf(file, "{\n  \"benchmarks\": [\n");
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+			fprintf(file, "    {\"name\": \"%s\", \"backend\": \"%s\", \"iterations\": %llu, \"ops_per_sec\": %.2f, \"bytes_per_sec\": %.2f, \"p50_ns\": %.2f, \"p99_ns\": %.2f, \"simulated_ns_per_op\": %.2f}%s\n",
+				r.name.c_str(), r.backend.c_str(), r.iterations, r.opsPerSec, r.bytesPerSec, r.p50Ns, r.p99Ns, r.simulatedNsPerOp, i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+		fclose(file);
+
+		printf("results written to %s\n", options.out.c_str());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--out") && i + 1 < argc)
+			options.out = argv[++i];
+		else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+			options.filter = argv[++i];
+		else if (!strcmp(argv[i], "--quick"))
+			options.quick = true;
+		else if (!strcmp(argv[i], "--verify"))
+			options.verify = true;
+	}
+
+	// numbers of broken code are worthless, do not benchmark it
+	if (verify() || options.verify)
+		return failures ? 1 : 0;
+
+	for (const auto kind : { "file", "sim" })
+	{
+		benchRead(kind);
+		benchScatter(kind);
+		benchScatterObjects(kind);
+		benchScatterArena(kind);
+		benchScatterHandles(kind);
+		benchBulkRead(kind);
+		benchRemoteStruct(kind);
+		benchAsyncScatter(kind);
+		benchPointerChains(kind);
+		benchConstruction(kind);
+		benchThreads(kind);
+	}
+	benchCoalescing();
+	benchPageCache();
+	benchReadPolicies();
+	benchPrefetch();
+	benchAsyncInit();
+	benchDeviceGroup();
+	benchPatternScan();
+	benchScanKernels();
+	benchShardedScan();
+
+	writeJson();
+	return 0;
+}